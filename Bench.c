@@ -0,0 +1,574 @@
+/*
+snl-bench: microbenchmarks for the server's hot functions (make bench).
+
+Usage: snl-bench [-t ms] [-f filter] [-o file] [-c file]
+  -t ms      time per benchmark (default 300)
+  -f filter  only run benchmarks whose name contains filter
+  -o file    also write the results as tab-separated values
+  -c file    compare against an earlier -o file (ns/op change in %)
+
+The functions are the server's own: Server.c is compiled into this binary
+(its main renamed), so a benchmark runs exactly the code the server runs,
+static helpers included, against in-process copies of the shared state:
+  board_turn          one move (snakes and ladders lookup)
+  build_board         the text board for a table of 5
+  build_positions     the "Positions:" line for a table of 5
+  record_win          a win on a scoreboard of 1M players
+  score_rank          a player's rank on that board
+  score_view          the top 10 shown after a round
+  log_event           one event through the log ring (enqueue + dequeue)
+  log_event_full      an event dropped because the ring is full
+  linebuf_pop         splitting buffered input into lines
+  linebuf_read_line   the same through recv() on a socketpair
+  hist_record         one sample into a turn phase histogram
+Each is calibrated to run for -t ms and the best of three runs is kept.
+Reported per operation: wall time, CPU cycles (perf counter, or the TSC if
+perf events are not available) and heap allocations.
+*/
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* The server's hot functions are static: compile it in, minus its main. */
+#define main snl_server_main
+#include "Server.c"
+#undef main
+
+#define BENCH_RUNS 3
+#define BENCH_SCORE_PLAYERS 1000000
+#define BENCH_SCORE_CAP (1 << 21)
+#define BENCH_RANDOM 4096
+#define BENCH_BIG_BOARD 10000
+#define BENCH_LINES 64
+#define BENCH_MAX 32
+
+/* ---------------- allocation counting ---------------- */
+
+/*
+ * Every heap allocation in the process goes through these (they interpose
+ * glibc's), so a benchmark's allocations are the difference of the count.
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void __libc_free(void *p);
+
+static unsigned long long alloc_count = 0;
+
+void *malloc(size_t size) {
+    alloc_count++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    alloc_count++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size) {
+    alloc_count++;
+    return __libc_realloc(p, size);
+}
+
+void free(void *p) {
+    __libc_free(p);
+}
+
+/* ---------------- cycle counting ---------------- */
+
+static int cycles_fd = -1;
+static const char *cycles_source = "none";
+
+static void cycles_open(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    cycles_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (cycles_fd >= 0) {
+        ioctl(cycles_fd, PERF_EVENT_IOC_ENABLE, 0);
+        cycles_source = "perf cpu-cycles (user)";
+        return;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    cycles_source = "tsc";
+#endif
+}
+
+static unsigned long long cycles_now(void) {
+    if (cycles_fd >= 0) {
+        unsigned long long v = 0;
+        if (read(cycles_fd, &v, sizeof(v)) == (ssize_t)sizeof(v)) {
+            return v;
+        }
+        return 0;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/* ---------------- fixtures ---------------- */
+
+static int rand_pos[BENCH_RANDOM];
+static int rand_dice[BENCH_RANDOM];
+static Board big_board;
+static char (*score_names)[MAX_NAME];
+static int bench_sock[2] = {-1, -1};
+
+/* A process-local stand-in for the shared segment: one table, a log ring, a scoreboard. */
+static int fixtures_init(void) {
+    game_size = sizeof(SharedGame) + sizeof(GameTable);
+    game = calloc(1, game_size);
+    unsigned long slots = DEFAULT_LOG_SLOTS;
+    LogSlot *ring = aligned_alloc(64, slots * sizeof(LogSlot));
+    if (!game || !ring) {
+        return -1;
+    }
+    game->table_count = 1;
+    game->target_players = MAX_PLAYERS;
+    game->log.slots = ring;
+    game->log.mask = slots - 1;
+    for (unsigned long i = 0; i < slots; i++) {
+        ring[i].seq = i;
+    }
+    sem_init(&game->log_items, 0, 0);
+    sem_init(&game->score_dirty, 0, 0);
+    pthread_mutex_init(&game->score_mutex, NULL);
+
+    GameTable *t = &game->tables[0];
+    pthread_mutex_init(&t->lock, NULL);
+    t->board_show_every = 3;
+    t->game_started = 1;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        t->connected[i] = 1;
+        snprintf(t->player_name[i], MAX_NAME, "player_%d", i + 1);
+    }
+    t->active_players = MAX_PLAYERS;
+    board_init_default(&board);
+
+    DiceRng rng;
+    dice_seed(&rng, 1, 0);
+    for (int i = 0; i < BENCH_RANDOM; i++) {
+        rand_pos[i] = (int)(dice_next(&rng) % (uint64_t)board_size(&board));
+        rand_dice[i] = dice_roll(&rng);
+    }
+
+    /* A 10000-square board with 1000 random jumps. */
+    int (*jumps)[2] = calloc(1000, sizeof(*jumps));
+    unsigned char *used = calloc(BENCH_BIG_BOARD + 1, 1);
+    int count = 0;
+    if (!jumps || !used) {
+        return -1;
+    }
+    while (count < 1000) {
+        int from = 2 + (int)(dice_next(&rng) % (BENCH_BIG_BOARD - 2));
+        int to = 1 + (int)(dice_next(&rng) % (BENCH_BIG_BOARD - 1));
+        if (used[from] || used[to] || from == to) {
+            continue;
+        }
+        used[from] = 1;
+        used[to] = 1;
+        jumps[count][0] = from;
+        jumps[count][1] = to;
+        count++;
+    }
+    char err[128];
+    if (board_build(&big_board, BENCH_BIG_BOARD, (const int (*)[2])jumps, count, 0, err, sizeof(err)) != 0) {
+        fprintf(stderr, "big board: %s\n", err);
+        return -1;
+    }
+    free(jumps);
+    free(used);
+
+    /* 1M players with a spread of win counts, ranked. */
+    scores_base = calloc(1, scoreboard_bytes(BENCH_SCORE_CAP));
+    score_names = calloc(BENCH_SCORE_PLAYERS, MAX_NAME);
+    if (!scores_base || !score_names) {
+        return -1;
+    }
+    scoreboard_attach(&scores, scores_base, BENCH_SCORE_CAP, 1);
+    scores_cap = BENCH_SCORE_CAP;
+    for (int i = 0; i < BENCH_SCORE_PLAYERS; i++) {
+        snprintf(score_names[i], MAX_NAME, "player%07d", i);
+        scoreboard_put(&scores, score_names[i], (int)(dice_next(&rng) % 200));
+    }
+    scoreboard_sort(&scores);
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, bench_sock) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/* ---------------- benchmarks ---------------- */
+
+static unsigned long bench_board_turn(long n) {
+    unsigned long sum = 0;
+    TurnResult r;
+    for (long i = 0; i < n; i++) {
+        int pos = rand_pos[i & (BENCH_RANDOM - 1)];
+        board_turn(&board, &pos, rand_dice[i & (BENCH_RANDOM - 1)], &r);
+        sum += (unsigned long)pos;
+    }
+    return sum;
+}
+
+static unsigned long bench_board_turn_big(long n) {
+    unsigned long sum = 0;
+    TurnResult r;
+    for (long i = 0; i < n; i++) {
+        int pos = (int)((unsigned)rand_pos[i & (BENCH_RANDOM - 1)] * 97u % BENCH_BIG_BOARD);
+        board_turn(&big_board, &pos, rand_dice[i & (BENCH_RANDOM - 1)], &r);
+        sum += (unsigned long)pos;
+    }
+    return sum;
+}
+
+/* Move the table's players around so every call draws a different board. */
+static void shuffle_table(GameTable *t, long i, int size) {
+    for (int s = 0; s < MAX_PLAYERS; s++) {
+        t->position[s] = 1 + rand_pos[(i * MAX_PLAYERS + s) & (BENCH_RANDOM - 1)] % size;
+    }
+}
+
+static unsigned long bench_build_board(long n) {
+    GameTable *t = &game->tables[0];
+    char text[BOARD_TEXT_MAX];
+    unsigned long sum = 0;
+    for (long i = 0; i < n; i++) {
+        shuffle_table(t, i, board_size(&board));
+        build_board_locked(t, text, sizeof(text));
+        sum += (unsigned char)text[i & 63];
+    }
+    return sum;
+}
+
+static unsigned long bench_build_board_big(long n) {
+    Board saved = board;
+    board = big_board;
+    unsigned long sum = bench_build_board(n);
+    board = saved;
+    return sum;
+}
+
+static unsigned long bench_build_positions(long n) {
+    GameTable *t = &game->tables[0];
+    char line[512];
+    unsigned long sum = 0;
+    for (long i = 0; i < n; i++) {
+        shuffle_table(t, i, board_size(&board));
+        build_positions_locked(t, line, sizeof(line));
+        sum += (unsigned char)line[i & 15];
+    }
+    return sum;
+}
+
+static unsigned long bench_record_win(long n) {
+    unsigned long sum = 0;
+    for (long i = 0; i < n; i++) {
+        record_win(score_names[(unsigned long)(i * 7919) % BENCH_SCORE_PLAYERS]);
+        /* The score writer drains the queue; here it is just emptied. */
+        if (game->win_count == WIN_QUEUE) {
+            game->win_count = 0;
+            game->win_head = 0;
+        }
+        sum += (unsigned long)game->win_count;
+    }
+    return sum;
+}
+
+static unsigned long bench_score_rank(long n) {
+    unsigned long sum = 0;
+    for (long i = 0; i < n; i++) {
+        int wins = 0;
+        sum += (unsigned long)score_rank_of(score_names[(unsigned long)(i * 104729) % BENCH_SCORE_PLAYERS], &wins);
+    }
+    return sum;
+}
+
+static unsigned long bench_score_view(long n) {
+    unsigned long sum = 0;
+    ScoreView v;
+    for (long i = 0; i < n; i++) {
+        score_view(&v);
+        sum += (unsigned long)v.top[0].wins;
+    }
+    return sum;
+}
+
+static unsigned long bench_log_event(long n) {
+    unsigned long sum = 0;
+    GameEvent ev;
+    for (long i = 0; i < n; i++) {
+        log_event(EV_TURN, 0, (int)(i % MAX_PLAYERS), (int)i, NULL);
+        sum += (unsigned long)dequeue_log(&game->log, &ev);
+    }
+    return sum;
+}
+
+static unsigned long bench_log_event_full(long n) {
+    /* Fill the ring, then every event is a drop. */
+    for (unsigned long i = 0; i <= game->log.mask; i++) {
+        log_event(EV_TURN, 0, 0, 0, NULL);
+    }
+    unsigned long long before = game->log_dropped;
+    for (long i = 0; i < n; i++) {
+        log_event(EV_TURN, 0, (int)(i % MAX_PLAYERS), (int)i, NULL);
+    }
+    unsigned long sum = (unsigned long)(game->log_dropped - before);
+
+    /* Empty it again for whoever runs next. */
+    for (unsigned long i = 0; i <= game->log.mask; i++) {
+        game->log.slots[i].seq = i;
+    }
+    game->log.enqueue_pos = 0;
+    game->log.dequeue_pos = 0;
+    return sum;
+}
+
+static const char bench_input[] = "roll\n@resync\nroll\nalice\n";
+
+static unsigned long bench_linebuf_pop(long n) {
+    LineBuf lb;
+    linebuf_init(&lb, -1);
+    char line[512];
+    unsigned long sum = 0;
+    long done = 0;
+    while (done < n) {
+        /* Refill the buffer with whole copies of the input. */
+        lb.head = 0;
+        lb.len = 0;
+        while (lb.len + sizeof(bench_input) - 1 <= sizeof(lb.data)) {
+            memcpy(lb.data + lb.len, bench_input, sizeof(bench_input) - 1);
+            lb.len += sizeof(bench_input) - 1;
+        }
+        int len;
+        while (done < n && (len = linebuf_pop(&lb, line, sizeof(line))) >= 0) {
+            sum += (unsigned long)len;
+            done++;
+        }
+    }
+    return sum;
+}
+
+static unsigned long bench_linebuf_read_line(long n) {
+    LineBuf lb;
+    linebuf_init(&lb, bench_sock[1]);
+    char batch[BENCH_LINES * 5];
+    for (int i = 0; i < BENCH_LINES; i++) {
+        memcpy(batch + i * 5, "roll\n", 5);
+    }
+    char line[512];
+    unsigned long sum = 0;
+    for (long done = 0; done < n; done += BENCH_LINES) {
+        if (write(bench_sock[0], batch, sizeof(batch)) != (ssize_t)sizeof(batch)) {
+            break;
+        }
+        for (int i = 0; i < BENCH_LINES; i++) {
+            sum += (unsigned long)linebuf_read_line(&lb, line, sizeof(line));
+        }
+    }
+    return sum;
+}
+
+static unsigned long bench_hist_record(long n) {
+    Histogram *h = &game->metrics.phase[PHASE_THINK];
+    for (long i = 0; i < n; i++) {
+        hist_record(h, (long long)rand_pos[i & (BENCH_RANDOM - 1)] * 1000);
+    }
+    return (unsigned long)h->count;
+}
+
+typedef struct {
+    const char *name;
+    const char *input;
+    unsigned long (*run)(long n);
+    int batch;   /* ops must be a multiple of this */
+} Bench;
+
+static const Bench benches[] = {
+    {"board_turn", "built-in board, random squares", bench_board_turn, 1},
+    {"board_turn_big", "10000 squares, 1000 jumps", bench_board_turn_big, 1},
+    {"build_board", "built-in board, 5 players", bench_build_board, 1},
+    {"build_board_big", "10000 squares, 5 players", bench_build_board_big, 1},
+    {"build_positions", "5 players", bench_build_positions, 1},
+    {"record_win", "1M players, returning winners", bench_record_win, 1},
+    {"score_rank", "1M players", bench_score_rank, 1},
+    {"score_view", "1M players, top 10", bench_score_view, 1},
+    {"log_event", "enqueue + dequeue", bench_log_event, 1},
+    {"log_event_full", "ring full, dropped", bench_log_event_full, 1},
+    {"linebuf_pop", "short lines, in memory", bench_linebuf_pop, 1},
+    {"linebuf_read_line", "socketpair, 64 lines per write", bench_linebuf_read_line, BENCH_LINES},
+    {"hist_record", "turn phase histogram", bench_hist_record, 1},
+};
+
+typedef struct {
+    long ops;
+    double ns;
+    double cycles;
+    double allocs;
+} BenchResult;
+
+static volatile unsigned long bench_sink;
+
+static BenchResult bench_measure(const Bench *b, long n) {
+    BenchResult r;
+    unsigned long long allocs = alloc_count;
+    unsigned long long c0 = cycles_now();
+    long long t0 = now_ns();
+    bench_sink += b->run(n);
+    long long t1 = now_ns();
+    unsigned long long c1 = cycles_now();
+    r.ops = n;
+    r.ns = (double)(t1 - t0) / (double)n;
+    r.cycles = (double)(c1 - c0) / (double)n;
+    r.allocs = (double)(alloc_count - allocs) / (double)n;
+    return r;
+}
+
+/* Grow n until a run takes a few ms, scale it to the target time, keep the best of BENCH_RUNS. */
+static BenchResult bench_run(const Bench *b, double target_ms) {
+    long n = b->batch;
+    BenchResult r = bench_measure(b, n);
+    while (r.ns * (double)n < 5e6 && n < (1L << 40)) {
+        n *= 4;
+        r = bench_measure(b, n);
+    }
+    double want = target_ms * 1e6 / BENCH_RUNS / r.ns;
+    n = want < (double)b->batch ? b->batch : (long)want / b->batch * b->batch;
+    BenchResult best = bench_measure(b, n);
+    for (int i = 1; i < BENCH_RUNS; i++) {
+        r = bench_measure(b, n);
+        if (r.ns < best.ns) {
+            best = r;
+        }
+    }
+    return best;
+}
+
+/* ns/op of each benchmark in an earlier -o file; -1 where it has none. */
+static void load_baseline(const char *path, double *base) {
+    for (size_t i = 0; i < BENCH_MAX; i++) {
+        base[i] = -1;
+    }
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        return;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), fp)) {
+        char name[64];
+        double ns;
+        if (line[0] == '#' || sscanf(line, "%63s %lf", name, &ns) != 2) {
+            continue;
+        }
+        for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+            if (strcmp(name, benches[i].name) == 0) {
+                base[i] = ns;
+            }
+        }
+    }
+    fclose(fp);
+}
+
+static void bench_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-t ms] [-f filter] [-o file] [-c file]\n", prog);
+    fprintf(stderr, "  -t ms      time per benchmark (default 300)\n");
+    fprintf(stderr, "  -f filter  only benchmarks whose name contains filter\n");
+    fprintf(stderr, "  -o file    write results as tab-separated values\n");
+    fprintf(stderr, "  -c file    compare ns/op against an earlier -o file\n");
+}
+
+int main(int argc, char **argv) {
+    double target_ms = 300;
+    const char *filter = NULL;
+    const char *out_path = NULL;
+    const char *base_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:f:o:c:h")) != -1) {
+        switch (opt) {
+        case 't':
+            target_ms = atof(optarg);
+            break;
+        case 'f':
+            filter = optarg;
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        case 'c':
+            base_path = optarg;
+            break;
+        default:
+            bench_usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (target_ms <= 0) {
+        bench_usage(argv[0]);
+        return 1;
+    }
+
+    double base[BENCH_MAX];
+    if (base_path) {
+        load_baseline(base_path, base);
+    }
+    if (fixtures_init() != 0) {
+        perror("snl-bench setup");
+        return 1;
+    }
+    cycles_open();
+
+    FILE *out = NULL;
+    if (out_path) {
+        out = fopen(out_path, "w");
+        if (!out) {
+            perror(out_path);
+            return 1;
+        }
+        fprintf(out, "# snl-bench\tcycles=%s\n", cycles_source);
+        fprintf(out, "# name\tns_per_op\tcycles_per_op\tallocs_per_op\tops\n");
+    }
+
+    printf("snl-bench: %.0f ms per benchmark, best of %d, cycles from %s\n", target_ms, BENCH_RUNS, cycles_source);
+    printf("%-18s %10s %10s %9s %11s%s  %s\n", "benchmark", "ns/op", "cycles/op", "allocs/op", "ops",
+           base_path ? "   change" : "", "input");
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        const Bench *b = &benches[i];
+        if (filter && !strstr(b->name, filter)) {
+            continue;
+        }
+        BenchResult r = bench_run(b, target_ms);
+        char change[16] = "";
+        if (base_path) {
+            if (base[i] > 0) {
+                snprintf(change, sizeof(change), "  %+6.1f%%", (r.ns - base[i]) / base[i] * 100.0);
+            } else {
+                snprintf(change, sizeof(change), "  %7s", "new");
+            }
+        }
+        printf("%-18s %10.1f %10.1f %9.2f %11ld%s  %s\n", b->name, r.ns, r.cycles, r.allocs, r.ops, change,
+               b->input);
+        fflush(stdout);
+        if (out) {
+            fprintf(out, "%s\t%.2f\t%.1f\t%.3f\t%ld\n", b->name, r.ns, r.cycles, r.allocs, r.ops);
+        }
+    }
+    if (out) {
+        fclose(out);
+    }
+    close(bench_sock[0]);
+    close(bench_sock[1]);
+    return 0;
+}
@@ -0,0 +1,283 @@
+/*
+Board: flat jump tables (see Board.h).
+*/
+
+#include "Board.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* dest[i] for the built-in board: the jump target if i starts one, else i. */
+#define DEFAULT_JUMP_IF(i, from, to) (i) == (from) ? (to) :
+#define DEFAULT_CELL(i) (BOARD_DEFAULT_JUMPS(DEFAULT_JUMP_IF, i) (i))
+#define DEFAULT_ROW(r) \
+    DEFAULT_CELL((r) + 0), DEFAULT_CELL((r) + 1), DEFAULT_CELL((r) + 2), DEFAULT_CELL((r) + 3), \
+    DEFAULT_CELL((r) + 4), DEFAULT_CELL((r) + 5), DEFAULT_CELL((r) + 6), DEFAULT_CELL((r) + 7), \
+    DEFAULT_CELL((r) + 8), DEFAULT_CELL((r) + 9)
+
+_Static_assert(BOARD_DEFAULT_SIZE == 100, "built-in board table is written out for 100 squares");
+_Static_assert(DEFAULT_CELL(BOARD_DEFAULT_SIZE) == BOARD_DEFAULT_SIZE, "no jump from the last square");
+
+const int board_default_dest[BOARD_DEFAULT_SIZE + 1] = {
+    DEFAULT_ROW(0), DEFAULT_ROW(10), DEFAULT_ROW(20), DEFAULT_ROW(30), DEFAULT_ROW(40),
+    DEFAULT_ROW(50), DEFAULT_ROW(60), DEFAULT_ROW(70), DEFAULT_ROW(80), DEFAULT_ROW(90),
+    DEFAULT_CELL(100)
+};
+
+void board_init_default(Board *b) {
+    b->size = BOARD_DEFAULT_SIZE;
+    b->cols = 10;
+    b->jumps = BOARD_DEFAULT_JUMP_COUNT;
+    b->chains = 1;   /* ladder 6 -> 25 ends on the snake at 25 */
+    b->follow = 0;
+    b->dest = board_default_dest;
+    b->owned = NULL;
+}
+
+/*
+ * Point every jump straight at the square its chain ends on. Each square is
+ * walked once: state 1 marks the chain being followed, 2 a resolved jump.
+ * Returns the number of chained jumps, or -1 (and the square) on a cycle.
+ */
+static int resolve_chains(int *dest, int size, int *cycle_at) {
+    unsigned char *state = calloc((size_t)size + 1, 1);
+    int *path = malloc(((size_t)size + 1) * sizeof(int));
+    if (!state || !path) {
+        free(state);
+        free(path);
+        *cycle_at = 0;
+        return -1;
+    }
+
+    int chains = 0;
+    for (int i = 1; i <= size; i++) {
+        if (state[i] != 0 || dest[i] == i) {
+            continue;
+        }
+        int depth = 0;
+        int j = i;
+        while (dest[j] != j && state[j] == 0) {
+            state[j] = 1;
+            path[depth++] = j;
+            j = dest[j];
+        }
+        if (state[j] == 1) {
+            free(state);
+            free(path);
+            *cycle_at = j;
+            return -1;
+        }
+        int end = state[j] == 2 ? dest[j] : j;
+        for (int k = 0; k < depth; k++) {
+            if (dest[path[k]] != end) {
+                chains++;
+            }
+            dest[path[k]] = end;
+            state[path[k]] = 2;
+        }
+    }
+    free(state);
+    free(path);
+    return chains;
+}
+
+int board_build(Board *b, int size, const int (*jumps)[2], int count, int follow,
+                char *err, size_t err_len) {
+    if (size < 2 || size > BOARD_MAX_SIZE) {
+        snprintf(err, err_len, "size %d out of range (2-%d)", size, BOARD_MAX_SIZE);
+        return -1;
+    }
+    int *dest = malloc(((size_t)size + 1) * sizeof(int));
+    if (!dest) {
+        snprintf(err, err_len, "out of memory for %d squares", size);
+        return -1;
+    }
+    for (int i = 0; i <= size; i++) {
+        dest[i] = i;
+    }
+    for (int j = 0; j < count; j++) {
+        int from = jumps[j][0];
+        int to = jumps[j][1];
+        if (from < 1 || from >= size || to < 1 || to > size || from == to) {
+            snprintf(err, err_len, "bad jump %d -> %d", from, to);
+            free(dest);
+            return -1;
+        }
+        if (dest[from] != from) {
+            snprintf(err, err_len, "two jumps start on square %d", from);
+            free(dest);
+            return -1;
+        }
+        dest[from] = to;
+    }
+
+    int cycle_at = 0;
+    int chains = 0;
+    if (follow) {
+        chains = resolve_chains(dest, size, &cycle_at);
+    } else {
+        for (int j = 0; j < count; j++) {
+            int to = jumps[j][1];
+            chains += dest[to] != to;
+        }
+    }
+    if (chains < 0) {
+        if (cycle_at > 0) {
+            snprintf(err, err_len, "jumps form a cycle through square %d", cycle_at);
+        } else {
+            snprintf(err, err_len, "out of memory resolving jumps");
+        }
+        free(dest);
+        return -1;
+    }
+
+    b->size = size;
+    b->cols = 10;
+    b->jumps = count;
+    b->chains = chains;
+    b->follow = follow;
+    b->dest = dest;
+    b->owned = dest;
+    return 0;
+}
+
+int board_load(Board *b, const char *path, char *err, size_t err_len) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        snprintf(err, err_len, "%s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    int size = 0;
+    int cols = 10;
+    int follow = 0;
+    int count = 0;
+    int cap = 0;
+    int (*jumps)[2] = NULL;
+    char line[256];
+    int line_no = 0;
+    int rc = 0;
+    while (rc == 0 && fgets(line, sizeof(line), fp)) {
+        line_no++;
+        char *hash = strchr(line, '#');
+        if (hash) {
+            *hash = '\0';
+        }
+        char word[16];
+        char mode[16];
+        int a = 0;
+        int c = 0;
+        int fields = sscanf(line, "%15s %d %d", word, &a, &c);
+        if (fields <= 0) {
+            continue;
+        }
+
+        if (strcmp(word, "chains") == 0 && sscanf(line, "%*s %15s", mode) == 1 &&
+            (strcmp(mode, "follow") == 0 || strcmp(mode, "stop") == 0)) {
+            follow = mode[0] == 'f';
+        } else if (strcmp(word, "size") == 0 && fields == 2) {
+            size = a;
+        } else if (strcmp(word, "cols") == 0 && fields == 2 && a >= 1 && a <= BOARD_MAX_COLS) {
+            cols = a;
+        } else if (fields == 3 && (strcmp(word, "snake") == 0 || strcmp(word, "ladder") == 0 ||
+                                   strcmp(word, "jump") == 0)) {
+            if ((word[0] == 's' && c >= a) || (word[0] == 'l' && c <= a)) {
+                snprintf(err, err_len, "%s:%d: a %s must go %s", path, line_no, word,
+                         word[0] == 's' ? "down" : "up");
+                rc = -1;
+                break;
+            }
+            if (count == cap) {
+                cap = cap ? cap * 2 : 64;
+                int (*grown)[2] = realloc(jumps, (size_t)cap * sizeof(*jumps));
+                if (!grown) {
+                    snprintf(err, err_len, "%s:%d: out of memory", path, line_no);
+                    rc = -1;
+                    break;
+                }
+                jumps = grown;
+            }
+            jumps[count][0] = a;
+            jumps[count][1] = c;
+            count++;
+        } else {
+            snprintf(err, err_len, "%s:%d: cannot parse \"%s\"", path, line_no, word);
+            rc = -1;
+        }
+    }
+    fclose(fp);
+
+    if (rc == 0 && size == 0) {
+        snprintf(err, err_len, "%s: no \"size\" line", path);
+        rc = -1;
+    }
+    if (rc == 0) {
+        char why[128];
+        if (board_build(b, size, (const int (*)[2])jumps, count, follow, why, sizeof(why)) != 0) {
+            snprintf(err, err_len, "%s: %s", path, why);
+            rc = -1;
+        } else {
+            b->cols = cols;
+        }
+    }
+    free(jumps);
+    return rc;
+}
+
+void board_free(Board *b) {
+    free(b->owned);
+    b->owned = NULL;
+    b->dest = NULL;
+}
+
+/* Mix the four bytes of w into an FNV-1a hash. */
+static uint64_t fnv1a_word(uint64_t h, uint32_t w) {
+    for (int k = 0; k < 4; k++) {
+        h ^= (w >> (8 * k)) & 0xFFu;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+uint64_t board_id(const Board *b) {
+    int size = board_size(b);
+#ifdef SNL_FIXED_BOARD
+    const int *dest = board_default_dest;
+#else
+    const int *dest = b->dest;
+#endif
+    uint64_t h = fnv1a_word(14695981039346656037ull, (uint32_t)size);
+    for (int i = 0; i <= size; i++) {
+        h = fnv1a_word(h, (uint32_t)dest[i]);
+    }
+    return h;
+}
+
+size_t board_bytes(const Board *b) {
+    return ((size_t)board_size(b) + 1) * sizeof(int);
+}
+
+double board_move_ns(const Board *b, int moves) {
+    int size = board_size(b);
+    unsigned int seed = 12345u;
+    int pos = 0;
+    long long sum = 0;
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < moves; i++) {
+        /* Jump around the whole board so large tables are measured cold. */
+        seed = seed * 1103515245u + 12345u;
+        int landed = 0;
+        pos = board_move(b, (int)((seed >> 8) % (unsigned int)size), (int)(seed % 6) + 1, &landed);
+        sum += pos;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    /* Keep the loop from being optimized away. */
+    __asm__ volatile("" : : "r"(sum) : "memory");
+    double ns = (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+    return moves > 0 ? ns / moves : 0.0;
+}
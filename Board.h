@@ -0,0 +1,135 @@
+/*
+Board: the squares of a snakes and ladders board as one flat jump table.
+
+dest[i] is where a piece that lands on square i ends up: the foot of a snake,
+the top of a ladder, or i itself. The table is built once per board, so a
+move is one bounds check and one load however many snakes and ladders the
+board has.
+
+Boards can be loaded from a text file (board_load). As on the built-in board,
+a piece takes at most one jump per move. A board may instead ask for chains
+to be followed ("chains follow"): a jump that lands on the start of another
+jump is then resolved to its end when the table is built, so a move still
+needs one lookup, and a cycle of jumps is rejected.
+
+Building with -DSNL_FIXED_BOARD compiles the built-in board into the move
+path: the size and table are constants and board files are not accepted.
+*/
+
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BOARD_DEFAULT_SIZE 100
+#define BOARD_MAX_SIZE 1000000
+#define BOARD_MAX_COLS 20
+
+/* Built-in snakes and ladders as X(i, from, to) entries. */
+#define BOARD_DEFAULT_JUMPS(X, i) \
+    X(i, 99, 54) X(i, 70, 55) X(i, 52, 42) X(i, 25, 2) \
+    X(i, 6, 25) X(i, 11, 40) X(i, 46, 90) X(i, 60, 85)
+#define BOARD_DEFAULT_JUMP_COUNT 8
+
+typedef struct {
+    int size;          /* last square; reaching it exactly wins */
+    int cols;          /* squares per row when the board is drawn */
+    int jumps;         /* number of snakes and ladders */
+    int chains;        /* jumps that end on the start of another jump */
+    int follow;        /* chains are followed (resolved into dest) */
+    const int *dest;   /* size + 1 entries */
+    int *owned;        /* heap table, NULL when dest is the built-in one */
+} Board;
+
+/* The built-in board, laid out at compile time. */
+extern const int board_default_dest[BOARD_DEFAULT_SIZE + 1];
+
+void board_init_default(Board *b);
+
+/*
+ * Build a board from (from, to) pairs. Squares run 1..size; a jump may not
+ * start on the last square and each square starts at most one jump. With
+ * follow set, chains are resolved and a cycle is an error. Returns 0, or -1
+ * with a message in err.
+ */
+int board_build(Board *b, int size, const int (*jumps)[2], int count, int follow,
+                char *err, size_t err_len);
+
+/*
+ * Load a board file:
+ *     size 1000          last square (required, 2..BOARD_MAX_SIZE)
+ *     cols 10            squares per drawn row (optional)
+ *     snake 99 54        head -> tail
+ *     ladder 6 25        foot -> top
+ *     jump 30 12         either direction
+ *     chains follow      keep jumping while landing on a jump (default: stop)
+ * '#' starts a comment. Returns 0, or -1 with "file:line: reason" in err.
+ */
+int board_load(Board *b, const char *path, char *err, size_t err_len);
+
+/* Fingerprint of the rules (FNV-1a over size and jump table), stored in game recordings. */
+uint64_t board_id(const Board *b);
+
+/* Bytes of jump table the board holds. */
+size_t board_bytes(const Board *b);
+
+/* Average cost of one board_move, timed over `moves` random rolls. */
+double board_move_ns(const Board *b, int moves);
+
+void board_free(Board *b);
+
+/*
+ * Where a roll from pos ends: *landed is the square the dice reach (pos when
+ * the roll overshoots the last square), the result is after any jump.
+ */
+static inline int board_move(const Board *b, int pos, int dice, int *landed) {
+#ifdef SNL_FIXED_BOARD
+    (void)b;
+    const int size = BOARD_DEFAULT_SIZE;
+    const int *dest = board_default_dest;
+#else
+    const int size = b->size;
+    const int *dest = b->dest;
+#endif
+    int target = pos + dice;
+    target = target <= size ? target : pos;
+    *landed = target;
+    return dest[target];
+}
+
+/* Last square of the board in play. */
+static inline int board_size(const Board *b) {
+#ifdef SNL_FIXED_BOARD
+    (void)b;
+    return BOARD_DEFAULT_SIZE;
+#else
+    return b->size;
+#endif
+}
+
+/* Outcome of one roll, shared by the server and snl-replay. */
+typedef struct {
+    int dice;
+    int before;
+    int after;
+    int moved;
+    int jump_from;
+    int jump_to;
+    int won;
+} TurnResult;
+
+/* Move the piece at *pos by one roll and say what happened (won = reached the last square). */
+static inline void board_turn(const Board *b, int *pos, int dice, TurnResult *r) {
+    int landed = 0;
+    r->dice = dice;
+    r->before = *pos;
+    r->after = board_move(b, r->before, dice, &landed);
+    r->moved = landed != r->before;
+    r->jump_from = r->after != landed ? landed : 0;
+    r->jump_to = r->after != landed ? r->after : 0;
+    r->won = r->after == board_size(b);
+    *pos = r->after;
+}
+
+#endif
@@ -13,29 +13,300 @@ Hadi:
 #include <stdlib.h>
 #include <string.h>
 
+#include "NetBuf.h"
+#include "Wire.h"
+
 #define PORT 5555
+#define WATCH_PORT 5556
+#define MAX_SEATS 8
+#define NAME_MAX_LEN 64
+#define SHOW_ROWS 10
+
+/*
+ * The board as the server last described it (@B, @S and @D lines), so it can
+ * be drawn here instead of being sent as text every few turns.
+ */
+static int board_squares = 0;
+static int board_cols = 10;
+static int seat_pos[MAX_SEATS];          /* -1 = empty seat */
+static char seat_name[MAX_SEATS][NAME_MAX_LEN];
+
+/* Same picture the server draws for text clients: serpentine rows, top first. */
+static void draw_board(void) {
+    if (board_squares <= 0 || board_cols <= 0) {
+        return;
+    }
+    int rows = (board_squares + board_cols - 1) / board_cols;
+    int width = snprintf(NULL, 0, "%d", board_squares);
+    if (width < 4) {
+        width = 4;
+    }
+    int skipped = 0;
 
-/* Read a line from the socket (newline-terminated). */
-static int recv_line(int sock, char *buf, size_t max_len) {
-    size_t idx = 0;
-    while (idx < max_len - 1) {
-        char c;
-        ssize_t n = recv(sock, &c, 1, 0);
-        if (n <= 0) {
-            return -1;
+    printf("\n----- Board -----\n");
+    for (int row = rows - 1; row >= 0; row--) {
+        int players_in_row = 0;
+        for (int i = 0; i < MAX_SEATS; i++) {
+            if (seat_pos[i] > 0 && (seat_pos[i] - 1) / board_cols == row) {
+                players_in_row++;
+            }
         }
-        if (c == '\n') {
-            break;
+        if (rows > SHOW_ROWS && row != rows - 1 && players_in_row == 0) {
+            skipped = 1;
+            continue;
+        }
+        if (skipped) {
+            printf("  ...\n");
+            skipped = 0;
+        }
+        int start = row * board_cols + 1;
+        for (int col = 0; col < board_cols; col++) {
+            int num = (row % 2 == 0) ? (start + col) : (start + (board_cols - 1 - col));
+            int players_here = 0;
+            int last_id = -1;
+            for (int i = 0; i < MAX_SEATS; i++) {
+                if (seat_pos[i] == num) {
+                    players_here++;
+                    last_id = i;
+                }
+            }
+
+            char cell[16];
+            if (num > board_squares) {
+                cell[0] = '\0';
+            } else if (players_here == 0) {
+                snprintf(cell, sizeof(cell), "%d", num);
+            } else if (players_here == 1) {
+                snprintf(cell, sizeof(cell), "P%d", last_id + 1);
+            } else {
+                snprintf(cell, sizeof(cell), "M%d", players_here);
+            }
+            printf("[%*s]", width, cell);
+        }
+        printf("\n");
+    }
+    printf("-----------------\n");
+
+    printf("Positions:");
+    for (int i = 0; i < MAX_SEATS; i++) {
+        if (seat_pos[i] >= 0) {
+            printf(" P%d=%s:%d", i + 1, seat_name[i], seat_pos[i]);
+        }
+    }
+    printf("\n");
+}
+
+/*
+ * Apply one "@" update line. A position for a seat we do not know means we
+ * missed a snapshot: ask for a new one.
+ */
+static void apply_update(int sock, char *line, int watching) {
+    char *save = NULL;
+    char *tok = strtok_r(line, " ", &save);
+    if (strcmp(tok, "@B") == 0) {
+        char *size = strtok_r(NULL, " ", &save);
+        char *cols = strtok_r(NULL, " ", &save);
+        if (size && cols) {
+            board_squares = atoi(size);
+            board_cols = atoi(cols);
+        }
+    } else if (strcmp(tok, "@S") == 0) {
+        for (int i = 0; i < MAX_SEATS; i++) {
+            seat_pos[i] = -1;
+        }
+        while ((tok = strtok_r(NULL, " ", &save)) != NULL) {
+            int seat = 0;
+            int pos = 0;
+            int name_at = 0;
+            if (sscanf(tok, "%d:%d:%n", &seat, &pos, &name_at) == 2 && name_at > 0 &&
+                seat >= 1 && seat <= MAX_SEATS) {
+                seat_pos[seat - 1] = pos;
+                snprintf(seat_name[seat - 1], NAME_MAX_LEN, "%s", tok + name_at);
+            }
+        }
+        if (watching) {
+            draw_board();
+        }
+    } else if (strcmp(tok, "@D") == 0) {
+        while ((tok = strtok_r(NULL, " ", &save)) != NULL) {
+            int seat = 0;
+            int pos = 0;
+            if (sscanf(tok, "%d:%d", &seat, &pos) != 2 || seat < 1 || seat > MAX_SEATS) {
+                continue;
+            }
+            if (seat_pos[seat - 1] < 0) {
+                send(sock, "@resync\n", 8, 0);
+            }
+            seat_pos[seat - 1] = pos;
+        }
+    } else if (strcmp(tok, "@R") == 0) {
+        draw_board();
+    }
+}
+
+/* Print a server line, or apply it if it is a board update. */
+static void handle_line(int sock, char *line, int watching) {
+    if (line[0] == '@' && line[1] != '\0') {
+        apply_update(sock, line, watching);
+    } else {
+        printf("%s\n", line);
+    }
+}
+
+/* Name of a seat as last seen in a snapshot. */
+static const char *name_of(int seat) {
+    if (seat < 0 || seat >= MAX_SEATS || !seat_name[seat][0]) {
+        return "?";
+    }
+    return seat_name[seat];
+}
+
+static void print_scoreboard(const WireMsg *m) {
+    if (m->count == 0) {
+        printf("Scoreboard:\n  (no scores yet)\n");
+        return;
+    }
+    printf("Scoreboard (top %d of %u):\n", m->count, m->a);
+    int rank = 1;
+    for (int i = 0; i < m->count; i++) {
+        const WireEntry *e = &m->entries[i];
+        if (i > 0 && e->value != m->entries[i - 1].value) {
+            rank = i + 1;
+        }
+        printf("  %d) %.*s - %u wins\n", rank, e->name_len, e->name, e->value);
+    }
+    if (m->b > 0) {
+        printf("  You: #%u of %u (%u wins)\n", m->b, m->a, m->c);
+    }
+}
+
+/*
+ * Show one binary message the way the text protocol would have said it.
+ * Returns 1 when it is our turn to roll.
+ */
+static int handle_frame(int sock, const WireMsg *m) {
+    static int won_after_jump = -1;
+    switch (m->type) {
+    case WIRE_WELCOME:
+        board_squares = (int)m->b;
+        board_cols = (int)m->c;
+        printf("Welcome! You are P%d at table %u (%d/%d players connected).\n",
+               m->seat + 1, m->a + 1, m->u8a, m->u8b);
+        printf("Rules: first to reach %d wins (exact roll needed). Snakes down, ladders up.\n", board_squares);
+        break;
+    case WIRE_ROUND_START:
+        printf("Table %u: round %u started\n", m->a + 1, m->b);
+        break;
+    case WIRE_TURN_START:
+        if (m->u8a & WIRE_SHOW_BOARD) {
+            draw_board();
+        }
+        printf("YOUR_TURN: press ENTER to roll the dice.\n");
+        return 1;
+    case WIRE_ROLL_RESULT: {
+        const char *name = name_of(m->seat);
+        int jumped = m->b != m->a + m->u8a && !(m->u8b & WIRE_STAYED);
+        printf("Player %s rolled %d -> position %u\n", name, m->u8a, m->b);
+        if (m->u8b & WIRE_STAYED) {
+            printf("Exact roll needed to reach %d. %s stays in place.\n", board_squares, name);
+        }
+        won_after_jump = -1;
+        if ((m->u8b & WIRE_WON) && jumped) {
+            won_after_jump = m->seat;
+        } else if (m->u8b & WIRE_WON) {
+            printf("Player %s WON the game\n", name);
+        }
+        if (m->seat < MAX_SEATS) {
+            seat_pos[m->seat] = (int)m->b;
+        }
+        break;
+    }
+    case WIRE_JUMP:
+        printf("%s %u -> %u\n", m->b < m->a ? "Snake!" : "Ladder!", m->a, m->b);
+        if (won_after_jump == m->seat) {
+            printf("Player %s WON the game\n", name_of(m->seat));
+            won_after_jump = -1;
         }
-        if (c != '\r') {
-            buf[idx++] = c;
+        break;
+    case WIRE_POSITIONS:
+        for (int i = 0; i < m->count; i++) {
+            int seat = m->entries[i].seat;
+            if (seat >= MAX_SEATS) {
+                continue;
+            }
+            if (seat_pos[seat] < 0) {
+                /* A seat we never saw: our picture is stale. */
+                char hdr[WIRE_HEADER] = {0, 0, WIRE_RESYNC};
+                send(sock, hdr, sizeof(hdr), 0);
+            }
+            seat_pos[seat] = (int)m->entries[i].value;
         }
+        break;
+    case WIRE_PLAYERS:
+        for (int i = 0; i < MAX_SEATS; i++) {
+            seat_pos[i] = -1;
+        }
+        for (int i = 0; i < m->count; i++) {
+            const WireEntry *e = &m->entries[i];
+            if (e->seat < MAX_SEATS) {
+                seat_pos[e->seat] = (int)e->value;
+                snprintf(seat_name[e->seat], NAME_MAX_LEN, "%.*s", e->name_len, e->name);
+            }
+        }
+        break;
+    case WIRE_GAME_OVER:
+        printf("\n==============================\n");
+        if (m->seat != WIRE_NO_SEAT) {
+            printf("WINNER: %.*s\n", (int)m->text_len, m->text);
+        } else {
+            printf("GAME OVER\n");
+        }
+        printf("==============================\n");
+        break;
+    case WIRE_SCOREBOARD:
+        print_scoreboard(m);
+        break;
+    case WIRE_TEXT:
+        fwrite(m->text, 1, m->text_len, stdout);
+        break;
+    default:
+        break;
     }
-    buf[idx] = '\0';
-    return (int)idx;
+    return 0;
 }
 
-int main(void) {
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-w table] [-T | -L]\n", prog);
+    fprintf(stderr, "  -w table   watch a table instead of playing (0 = first table in play)\n");
+    fprintf(stderr, "  -T         plain text: the server draws the board (as for telnet)\n");
+    fprintf(stderr, "  -L         text lines with position updates instead of binary frames\n");
+}
+
+int main(int argc, char **argv) {
+    int watch_table = -1;
+    int text_mode = 0;
+    int line_mode = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "w:TLh")) != -1) {
+        switch (opt) {
+        case 'w':
+            watch_table = atoi(optarg);
+            if (watch_table < 0) {
+                watch_table = 0;
+            }
+            break;
+        case 'T':
+            text_mode = 1;
+            break;
+        case 'L':
+            line_mode = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
     /* Create TCP socket. */
     int sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock < 0) {
@@ -47,7 +318,7 @@ int main(void) {
     struct sockaddr_in server;
     memset(&server, 0, sizeof(server));
     server.sin_family = AF_INET;
-    server.sin_port = htons(PORT);
+    server.sin_port = htons(watch_table >= 0 ? WATCH_PORT : PORT);
     inet_pton(AF_INET, "127.0.0.1", &server.sin_addr);
 
     if (connect(sock, (struct sockaddr *)&server, sizeof(server)) < 0) {
@@ -55,9 +326,48 @@ int main(void) {
         return 1;
     }
 
+    /*
+     * Pick the protocol: binary frames for playing, position update lines
+     * for watching (or with -L), plain text with -T.
+     */
+    int binary = !text_mode && !line_mode && watch_table < 0;
+    if (binary) {
+        send(sock, "@binary\n", 8, 0);
+    } else if (!text_mode) {
+        send(sock, "@delta\n", 7, 0);
+    }
+    for (int i = 0; i < MAX_SEATS; i++) {
+        seat_pos[i] = -1;
+    }
+
+    LineBuf in;
+    linebuf_init(&in, sock);
+    char buffer[512];
+    int n;
+
+    /* Spectator: pick the table, then just print what the server sends. */
+    if (watch_table >= 0) {
+        if (linebuf_read_line(&in, buffer, sizeof(buffer)) < 0) {
+            close(sock);
+            return 1;
+        }
+        char pick[32];
+        if (watch_table > 0) {
+            snprintf(pick, sizeof(pick), "%d\n", watch_table);
+        } else {
+            snprintf(pick, sizeof(pick), "\n");
+        }
+        send(sock, pick, strlen(pick), 0);
+        while ((n = linebuf_read_line(&in, buffer, sizeof(buffer))) >= 0) {
+            handle_line(sock, buffer, 1);
+            fflush(stdout);
+        }
+        close(sock);
+        return 0;
+    }
+
     /* Receive prompt (name request). */
-    char buffer[256];
-    int n = recv_line(sock, buffer, sizeof(buffer));
+    n = linebuf_read_line(&in, buffer, sizeof(buffer));
     if (n >= 0) {
         if (n > 0) {
             printf("%s\n", buffer);
@@ -72,19 +382,43 @@ int main(void) {
         close(sock);
         return 0;
     }
+    if (binary) {
+        name[strcspn(name, "\r\n")] = '\0';
+        OutBuf out;
+        outbuf_init(&out, sock);
+        wire_text(&out, WIRE_JOIN, name);
+        outbuf_flush(&out);
+
+        /* Frames from here on; a roll is answered with WIRE_ROLL. */
+        uint8_t frame[LINEBUF_SIZE];
+        WireMsg m;
+        while ((n = wire_read(&in, frame)) >= 0) {
+            if (wire_decode(frame, (size_t)n, &m) != 0) {
+                fprintf(stderr, "bad frame from server\n");
+                break;
+            }
+            if (handle_frame(sock, &m)) {
+                printf("Press ENTER to roll...\n");
+                fflush(stdout);
+                fgets(buffer, sizeof(buffer), stdin);
+                wire_empty(&out, WIRE_ROLL);
+                outbuf_flush(&out);
+            }
+            fflush(stdout);
+        }
+        outbuf_free(&out);
+        close(sock);
+        return 0;
+    }
     send(sock, name, strlen(name), 0);
 
     /* Main receive loop. */
     while (1) {
-        n = recv_line(sock, buffer, sizeof(buffer));
+        n = linebuf_read_line(&in, buffer, sizeof(buffer));
         if (n < 0) {
             break;
         }
-        if (n > 0) {
-            printf("%s\n", buffer);
-        } else {
-            printf("\n");
-        }
+        handle_line(sock, buffer, 0);
 
         /* Only respond on your turn. */
         if (strncmp(buffer, "YOUR_TURN", 9) == 0) {
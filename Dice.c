@@ -0,0 +1,54 @@
+/*
+Dice: seeding and batched rolls (see Dice.h).
+*/
+
+#include "Dice.h"
+
+#include <sys/random.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void dice_seed(DiceRng *r, uint64_t seed, uint64_t stream) {
+    uint64_t x = seed ^ (stream * 0xD1B54A32D192ED03ull);
+    for (int i = 0; i < 4; i++) {
+        r->s[i] = splitmix64(&x);
+    }
+    /* All-zero state never leaves zero; splitmix64 cannot give four zeros, but be sure. */
+    if ((r->s[0] | r->s[1] | r->s[2] | r->s[3]) == 0) {
+        r->s[0] = 1;
+    }
+}
+
+uint64_t dice_entropy_seed(void) {
+    uint64_t seed;
+    if (getrandom(&seed, sizeof(seed), GRND_NONBLOCK) == (ssize_t)sizeof(seed)) {
+        return seed;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t x = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    x ^= (uint64_t)getpid() << 32;
+    return splitmix64(&x);
+}
+
+void dice_fill(DiceRng *r, uint8_t *out, size_t n) {
+    /* Work on a local copy: stores through out may alias *r, which would force reloads. */
+    DiceRng g = *r;
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        uint64_t x = dice_next(&g);
+        out[i] = (uint8_t)(dice_range_from(&g, (uint32_t)x, 6) + 1);
+        out[i + 1] = (uint8_t)(dice_range_from(&g, (uint32_t)(x >> 32), 6) + 1);
+    }
+    if (i < n) {
+        out[i] = (uint8_t)dice_roll(&g);
+    }
+    *r = g;
+}
@@ -0,0 +1,76 @@
+/*
+Dice: the game's random numbers.
+
+xoshiro256** with 256 bits of state, seeded through splitmix64 from a seed
+and a stream number, so every table (or simulator thread) gets its own
+independent sequence and the same seed always gives the same rolls. There
+is no global state and no lock: the owner of a DiceRng serializes its use
+(for a table, the table lock).
+
+Rolls use Lemire's multiply-shift range reduction with rejection, so every
+face is exactly equally likely. dice_fill produces a buffer of rolls at
+once, two per 64-bit draw.
+*/
+
+#ifndef DICE_H
+#define DICE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint64_t s[4];
+} DiceRng;
+
+/* Seed stream `stream` of `seed`; different streams do not overlap in practice. */
+void dice_seed(DiceRng *r, uint64_t seed, uint64_t stream);
+
+/* A seed from the kernel (getrandom), falling back to the clock and pid. */
+uint64_t dice_entropy_seed(void);
+
+/* Fill out[0 .. n - 1] with rolls 1..6. */
+void dice_fill(DiceRng *r, uint8_t *out, size_t n);
+
+static inline uint64_t dice_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t dice_next(DiceRng *r) {
+    uint64_t result = dice_rotl(r->s[1] * 5, 7) * 9;
+    uint64_t t = r->s[1] << 17;
+    r->s[2] ^= r->s[0];
+    r->s[3] ^= r->s[1];
+    r->s[1] ^= r->s[2];
+    r->s[0] ^= r->s[3];
+    r->s[2] ^= t;
+    r->s[3] = dice_rotl(r->s[3], 45);
+    return result;
+}
+
+/*
+ * Uniform 0 .. n - 1 from 32 random bits x (n >= 1): the high half of x * n,
+ * redrawing while the low half falls in the 2^32 mod n values that would
+ * make some results more likely than others.
+ */
+static inline uint32_t dice_range_from(DiceRng *r, uint32_t x, uint32_t n) {
+    uint64_t m = (uint64_t)x * n;
+    if ((uint32_t)m < n) {
+        uint32_t threshold = (uint32_t)-n % n;
+        while ((uint32_t)m < threshold) {
+            m = (uint64_t)(uint32_t)dice_next(r) * n;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+/* Uniform 0 .. n - 1. */
+static inline uint32_t dice_range(DiceRng *r, uint32_t n) {
+    return dice_range_from(r, (uint32_t)dice_next(r), n);
+}
+
+/* One roll, 1..6. */
+static inline int dice_roll(DiceRng *r) {
+    return (int)dice_range(r, 6) + 1;
+}
+
+#endif
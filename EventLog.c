@@ -0,0 +1,167 @@
+/*
+EventLog: binary game.log records shared by the server and snl-logdump.
+*/
+
+#include "EventLog.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Clock records re-anchor t_ms well before it can wrap. */
+#define EVLOG_REBASE_MS 0x7fffffffLL
+
+_Static_assert(sizeof(LogRecord) == EVLOG_RECORD_SIZE, "LogRecord must stay 24 bytes");
+
+size_t evlog_encode(const GameEvent *ev, int64_t *base_ms, unsigned char *out) {
+    size_t used = 0;
+    int64_t ms = ev->ts_ns / 1000000;
+    LogRecord rec;
+
+    if (*base_ms == 0 || ms < *base_ms || ms - *base_ms > EVLOG_REBASE_MS) {
+        *base_ms = ms;
+        memset(&rec, 0, sizeof(rec));
+        rec.type = EV_LOG_START;
+        rec.table = EVLOG_MAGIC;
+        rec.round_no = EVLOG_VERSION;
+        rec.from = (int32_t)(uint32_t)((uint64_t)ms >> 32);
+        rec.to = (int32_t)(uint32_t)((uint64_t)ms & 0xffffffffu);
+        memcpy(out + used, &rec, sizeof(rec));
+        used += sizeof(rec);
+    }
+
+    memset(&rec, 0, sizeof(rec));
+    rec.t_ms = (uint32_t)(ms - *base_ms);
+    rec.table = ev->table;
+    rec.round_no = ev->round_no;
+    rec.type = ev->type;
+    rec.seat = ev->seat;
+    rec.dice = ev->dice;
+    rec.flags = ev->flags;
+    rec.from = ev->from;
+    rec.to = ev->to;
+
+    if (ev->type == EV_JOIN) {
+        /* The name rides in whole raw records right after the event. */
+        size_t name_len = strnlen(ev->name, EVLOG_NAME_MAX - 1);
+        rec.dice = (uint8_t)name_len;
+        memcpy(out + used, &rec, sizeof(rec));
+        used += sizeof(rec);
+        size_t padded = (name_len + EVLOG_RECORD_SIZE - 1) / EVLOG_RECORD_SIZE * EVLOG_RECORD_SIZE;
+        memset(out + used, 0, padded);
+        memcpy(out + used, ev->name, name_len);
+        return used + padded;
+    }
+
+    memcpy(out + used, &rec, sizeof(rec));
+    return used + sizeof(rec);
+}
+
+void evlog_reader_init(EvlogReader *rd, const unsigned char *data, size_t len) {
+    rd->data = data;
+    rd->len = len;
+    rd->off = 0;
+    rd->base_ms = 0;
+}
+
+long long evlog_scan(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return -1;
+    }
+    long long size = (long long)st.st_size;
+    if (size == 0) {
+        return 0;
+    }
+    LogRecord rec;
+    if (pread(fd, &rec, sizeof(rec), 0) != (ssize_t)sizeof(rec) ||
+        rec.type != EV_LOG_START || rec.table != EVLOG_MAGIC || rec.round_no != EVLOG_VERSION) {
+        return -1;
+    }
+
+    /*
+     * Walk whole events, a chunk at a time: a join only counts once all its
+     * name records are there, and anything that does not decode ends the log.
+     */
+    unsigned char buf[EVLOG_RECORD_SIZE * 2048];
+    long long off = 0;
+    while (off < size) {
+        ssize_t n = pread(fd, buf, sizeof(buf), (off_t)off);
+        if (n <= 0) {
+            break;
+        }
+        size_t len = (size_t)n;
+        size_t pos = 0;
+        int bad = 0;
+        while (pos + sizeof(rec) <= len) {
+            memcpy(&rec, buf + pos, sizeof(rec));
+            if (rec.type == 0 || rec.type >= EV_TYPE_COUNT ||
+                (rec.type == EV_LOG_START && rec.table != EVLOG_MAGIC)) {
+                bad = 1;
+                break;
+            }
+            size_t need = sizeof(rec);
+            if (rec.type == EV_JOIN) {
+                size_t name_len = rec.dice < EVLOG_NAME_MAX ? rec.dice : EVLOG_NAME_MAX - 1;
+                need += (name_len + EVLOG_RECORD_SIZE - 1) / EVLOG_RECORD_SIZE * EVLOG_RECORD_SIZE;
+            }
+            if (pos + need > len) {
+                break;
+            }
+            pos += need;
+        }
+        off += (long long)pos;
+        /* No progress: a bad record, or an event cut short by the end of the file. */
+        if (bad || pos == 0) {
+            break;
+        }
+    }
+    return off;
+}
+
+int evlog_next(EvlogReader *rd, GameEvent *ev) {
+    LogRecord rec;
+    if (rd->off + sizeof(rec) > rd->len) {
+        return 0;
+    }
+    memcpy(&rec, rd->data + rd->off, sizeof(rec));
+    rd->off += sizeof(rec);
+    if (rec.type == 0 || rec.type >= EV_TYPE_COUNT) {
+        return -1;
+    }
+
+    memset(ev, 0, sizeof(*ev));
+    ev->type = rec.type;
+
+    if (rec.type == EV_LOG_START) {
+        if (rec.table != EVLOG_MAGIC) {
+            return -1;
+        }
+        rd->base_ms = (int64_t)(((uint64_t)(uint32_t)rec.from << 32) | (uint32_t)rec.to);
+        ev->ts_ns = rd->base_ms * 1000000;
+        ev->round_no = rec.round_no;
+        return 1;
+    }
+
+    ev->ts_ns = (rd->base_ms + rec.t_ms) * 1000000;
+    ev->table = rec.table;
+    ev->round_no = rec.round_no;
+    ev->seat = rec.seat;
+    ev->dice = rec.dice;
+    ev->flags = rec.flags;
+    ev->from = rec.from;
+    ev->to = rec.to;
+
+    if (rec.type == EV_JOIN) {
+        size_t name_len = rec.dice < EVLOG_NAME_MAX ? rec.dice : EVLOG_NAME_MAX - 1;
+        size_t padded = (name_len + EVLOG_RECORD_SIZE - 1) / EVLOG_RECORD_SIZE * EVLOG_RECORD_SIZE;
+        if (rd->off + padded > rd->len) {
+            return -1;
+        }
+        memcpy(ev->name, rd->data + rd->off, name_len);
+        ev->name[name_len] = '\0';
+        ev->dice = 0;
+        rd->off += padded;
+    }
+    return 1;
+}
@@ -0,0 +1,95 @@
+/*
+EventLog: binary game.log records shared by the server and snl-logdump.
+
+The server never formats log text. Producers fill in a GameEvent, the logger
+thread packs it into fixed 24-byte LogRecords, and snl-logdump turns the file
+back into the familiar text lines (or JSON). Records are in host byte order.
+*/
+
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EVLOG_MAGIC 0x454C4E53u   /* "SNLE" */
+#define EVLOG_VERSION 1
+#define EVLOG_NAME_MAX 32
+#define EVLOG_RECORD_SIZE 24
+
+/* Largest encoding of one event: a clock record, the event, two name records. */
+#define EVLOG_MAX_ENCODED (4 * EVLOG_RECORD_SIZE)
+
+typedef enum {
+    EV_LOG_START = 1,   /* clock base; written first and whenever t_ms would overflow */
+    EV_SERVER_START,    /* from = port */
+    EV_JOIN,            /* name follows in raw name records */
+    EV_LEAVE,
+    EV_ROUND_START,
+    EV_TABLE_PAUSED,
+    EV_TURN,
+    EV_ROLL,            /* dice, from = before, to = final square */
+    EV_TYPE_COUNT
+} EventType;
+
+/* EV_ROLL flags. */
+#define EVF_WON 0x01
+#define EVF_NO_MOVE 0x02   /* exact roll needed, player stayed */
+
+/* An event as the game code produces it (lives in the shared log ring). */
+typedef struct {
+    int64_t ts_ns;          /* CLOCK_REALTIME */
+    uint32_t table;
+    uint32_t round_no;
+    uint8_t type;
+    uint8_t seat;
+    uint8_t dice;
+    uint8_t flags;
+    int32_t from;
+    int32_t to;
+    char name[EVLOG_NAME_MAX];   /* EV_JOIN only */
+} GameEvent;
+
+/* On-disk record. */
+typedef struct {
+    uint32_t t_ms;          /* ms since the last EV_LOG_START */
+    uint32_t table;         /* EV_LOG_START: EVLOG_MAGIC */
+    uint32_t round_no;      /* EV_LOG_START: EVLOG_VERSION */
+    uint8_t type;
+    uint8_t seat;
+    uint8_t dice;           /* EV_JOIN: name length */
+    uint8_t flags;
+    int32_t from;           /* EV_LOG_START: base time, ms since the epoch (high half) */
+    int32_t to;             /* EV_LOG_START: base time (low half) */
+} LogRecord;
+
+/*
+ * Pack one event into out (at least EVLOG_MAX_ENCODED bytes). *base_ms is the
+ * writer's current clock base, 0 before the first record; a new EV_LOG_START is
+ * emitted when needed. Returns the number of bytes written.
+ */
+size_t evlog_encode(const GameEvent *ev, int64_t *base_ms, unsigned char *out);
+
+/*
+ * Check a game.log about to be appended to: the bytes to keep (whole events,
+ * so a torn record or a join missing its name records is cut off, as is
+ * anything after a record that does not decode; 0 for an empty file), or -1
+ * if it does not start with an EV_LOG_START record, e.g. a text log from an
+ * older server.
+ */
+long long evlog_scan(int fd);
+
+/* Sequential reader over an encoded buffer. */
+typedef struct {
+    const unsigned char *data;
+    size_t len;
+    size_t off;
+    int64_t base_ms;
+} EvlogReader;
+
+void evlog_reader_init(EvlogReader *rd, const unsigned char *data, size_t len);
+
+/* Decode the next event (EV_LOG_START records included): 1, 0 at end, -1 if corrupt. */
+int evlog_next(EvlogReader *rd, GameEvent *ev);
+
+#endif
@@ -0,0 +1,596 @@
+/*
+snl-loadgen: many scripted players from one process, for load tests.
+
+Usage: snl-loadgen [-n bots] [-a rate] [-k ms] [-d seconds] [-P proto]
+                   [-q turns] [-R ms] [-H host] [-p port]
+
+Every bot is a non-blocking connection driven by one epoll loop. A bot joins
+like ./client does (name "botN"), rolls when the server says it is its turn
+(after the think time), and times each roll until its result comes back.
+At the end (or on Ctrl+C) it prints connections, turns per second, turn
+latency percentiles and errors, so a server change can be measured against
+the same workload.
+*/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "NetBuf.h"
+#include "Wire.h"
+
+#define PORT 5555
+#define MAX_EVENTS 256
+
+typedef enum { PROTO_TEXT, PROTO_DELTA, PROTO_BINARY } BotProto;
+
+static const char *proto_name[] = {"text", "delta", "binary"};
+
+typedef enum {
+    BOT_IDLE,         /* not connected: waiting to (re)connect */
+    BOT_CONNECTING,   /* connect() in progress */
+    BOT_PROMPT,       /* waiting for the name prompt */
+    BOT_WAITING,      /* seated, not our turn */
+    BOT_THINKING,     /* our turn, roll is due at `due` */
+    BOT_ROLLED        /* roll sent at `rolled_at`, waiting for its result */
+} BotState;
+
+typedef struct {
+    int fd;
+    BotState state;
+    int queued;              /* in the think queue */
+    int turns;               /* own turns this session */
+    long long due;
+    long long rolled_at;
+    LineBuf in;
+    OutBuf out;
+} Bot;
+
+/* FIFO of bot numbers; every bot is in a given queue at most once. */
+typedef struct {
+    int *slot;
+    long long *when;
+    size_t cap;
+    size_t head;
+    size_t len;
+} BotQueue;
+
+typedef struct {
+    unsigned long long connects;
+    unsigned long long joined;
+    unsigned long long reconnects;
+    unsigned long long turns;
+    unsigned long long wins;
+    unsigned long long connect_errors;
+    unsigned long long closed;       /* server closed the connection */
+    unsigned long long resets;       /* recv/send error */
+    unsigned long long bad_frames;
+    unsigned long long quits;        /* left after -q turns */
+} LoadStats;
+
+static volatile sig_atomic_t running = 1;
+
+static Bot *bots;
+static int bot_count = 100;
+static BotProto proto = PROTO_BINARY;
+static long long think_us = 0;
+static long long reconnect_us = -1;   /* -1: do not reconnect */
+static int quit_turns = 0;            /* 0: stay until the end */
+static struct sockaddr_in server_addr;
+static int epfd;
+static LoadStats stats;
+static BotQueue think_q;
+static BotQueue connect_q;
+
+/* Turn latencies in microseconds, sorted at the end. */
+static uint32_t *lat;
+static size_t lat_len;
+static size_t lat_cap;
+
+static void handle_sigint(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static long long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static int queue_init(BotQueue *q, size_t cap) {
+    q->slot = malloc(cap * sizeof(int));
+    q->when = malloc(cap * sizeof(long long));
+    q->cap = cap;
+    q->head = 0;
+    q->len = 0;
+    return q->slot && q->when ? 0 : -1;
+}
+
+static void queue_push(BotQueue *q, int id, long long when) {
+    size_t i = (q->head + q->len) % q->cap;
+    q->slot[i] = id;
+    q->when[i] = when;
+    q->len++;
+}
+
+/* Next bot whose time has come, or -1. */
+static int queue_pop_due(BotQueue *q, long long now) {
+    if (q->len == 0 || q->when[q->head] > now) {
+        return -1;
+    }
+    int id = q->slot[q->head];
+    q->head = (q->head + 1) % q->cap;
+    q->len--;
+    return id;
+}
+
+static void record_latency(long long us) {
+    if (lat_len == lat_cap) {
+        size_t cap = lat_cap ? lat_cap * 2 : 65536;
+        uint32_t *grown = realloc(lat, cap * sizeof(uint32_t));
+        if (!grown) {
+            return;
+        }
+        lat = grown;
+        lat_cap = cap;
+    }
+    lat[lat_len++] = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+static void bot_close(int id, unsigned long long *counter) {
+    Bot *b = &bots[id];
+    if (counter) {
+        (*counter)++;
+    }
+    epoll_ctl(epfd, EPOLL_CTL_DEL, b->fd, NULL);
+    close(b->fd);
+    outbuf_free(&b->out);
+    b->fd = -1;
+    b->state = BOT_IDLE;
+    if (reconnect_us >= 0 && running) {
+        queue_push(&connect_q, id, now_us() + reconnect_us);
+    }
+}
+
+static void bot_connect(int id) {
+    Bot *b = &bots[id];
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        stats.connect_errors++;
+        if (reconnect_us >= 0) {
+            queue_push(&connect_q, id, now_us() + (reconnect_us > 0 ? reconnect_us : 1000));
+        }
+        return;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    b->fd = fd;
+    b->turns = 0;
+    linebuf_init(&b->in, fd);
+    outbuf_init(&b->out, fd);
+    stats.connects++;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+    ev.data.u32 = (uint32_t)id;
+    if (connect(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0 && errno != EINPROGRESS) {
+        close(fd);
+        b->fd = -1;
+        stats.connect_errors++;
+        if (reconnect_us >= 0) {
+            queue_push(&connect_q, id, now_us() + (reconnect_us > 0 ? reconnect_us : 1000));
+        }
+        return;
+    }
+    b->state = BOT_CONNECTING;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+/* Queue output and push it out; a full socket is retried on EPOLLOUT. */
+static int bot_flush(int id) {
+    Bot *b = &bots[id];
+    int rc = outbuf_flush(&b->out);
+    if (rc < 0) {
+        bot_close(id, &stats.resets);
+        return -1;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | (rc > 0 ? EPOLLOUT : 0);
+    ev.data.u32 = (uint32_t)id;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, b->fd, &ev);
+    return 0;
+}
+
+static void bot_roll(int id) {
+    Bot *b = &bots[id];
+    if (proto == PROTO_BINARY) {
+        wire_empty(&b->out, WIRE_ROLL);
+    } else {
+        outbuf_puts(&b->out, "roll\n");
+    }
+    b->state = BOT_ROLLED;
+    b->rolled_at = now_us();
+    bot_flush(id);
+}
+
+static void bot_your_turn(int id) {
+    Bot *b = &bots[id];
+    if (think_us == 0) {
+        bot_roll(id);
+        return;
+    }
+    b->state = BOT_THINKING;
+    b->due = now_us() + think_us;
+    if (!b->queued) {
+        b->queued = 1;
+        queue_push(&think_q, id, b->due);
+    }
+}
+
+/* Our roll came back: the first result after a roll is always our own. */
+static void bot_rolled(int id, int won) {
+    Bot *b = &bots[id];
+    if (b->state != BOT_ROLLED) {
+        return;
+    }
+    record_latency(now_us() - b->rolled_at);
+    stats.turns++;
+    stats.wins += won != 0;
+    b->state = BOT_WAITING;
+    b->turns++;
+    if (quit_turns > 0 && b->turns >= quit_turns) {
+        bot_close(id, &stats.quits);
+    }
+}
+
+/* Name prompt seen: pick the protocol and join. */
+static void bot_join(int id) {
+    Bot *b = &bots[id];
+    char name[32];
+    snprintf(name, sizeof(name), "bot%d", id + 1);
+    if (proto == PROTO_BINARY) {
+        wire_text(&b->out, WIRE_JOIN, name);
+    } else {
+        outbuf_printf(&b->out, "%s\n", name);
+    }
+    b->state = BOT_WAITING;
+    stats.joined++;
+    bot_flush(id);
+}
+
+/* Handle what is buffered; -1 if the bot was closed. */
+static int bot_input(int id) {
+    Bot *b = &bots[id];
+    char line[LINEBUF_SIZE];
+    uint8_t frame[LINEBUF_SIZE];
+    WireMsg m;
+    int n;
+
+    while (b->state == BOT_PROMPT) {
+        if (linebuf_pop(&b->in, line, sizeof(line)) < 0) {
+            return 0;
+        }
+        if (strncmp(line, "Enter your name", 15) == 0) {
+            bot_join(id);
+        }
+    }
+    if (b->fd < 0) {
+        return -1;
+    }
+    if (proto == PROTO_BINARY) {
+        while ((n = wire_pop(&b->in, frame)) >= 0) {
+            if (wire_decode(frame, (size_t)n, &m) != 0) {
+                bot_close(id, &stats.bad_frames);
+                return -1;
+            }
+            if (m.type == WIRE_TURN_START) {
+                bot_your_turn(id);
+            } else if (m.type == WIRE_ROLL_RESULT) {
+                bot_rolled(id, m.u8b & WIRE_WON);
+            }
+            if (b->fd < 0) {
+                return -1;
+            }
+        }
+        if (n == WIRE_TOO_BIG) {
+            bot_close(id, &stats.bad_frames);
+            return -1;
+        }
+        return 0;
+    }
+    while ((n = linebuf_pop(&b->in, line, sizeof(line))) >= 0) {
+        if (strncmp(line, "YOUR_TURN", 9) == 0) {
+            bot_your_turn(id);
+        } else if (strncmp(line, "Player ", 7) == 0 && strstr(line, " rolled ")) {
+            bot_rolled(id, 0);
+        } else if (strncmp(line, "Player bot", 10) == 0 && atoi(line + 10) == id + 1 &&
+                   strstr(line, " WON the game")) {
+            stats.wins++;
+        }
+        if (b->fd < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void bot_event(int id, uint32_t events) {
+    Bot *b = &bots[id];
+    if (b->fd < 0) {
+        return;
+    }
+    if (b->state == BOT_CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(b->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0 || (events & EPOLLERR)) {
+            bot_close(id, &stats.connect_errors);
+            return;
+        }
+        b->state = BOT_PROMPT;
+        if (proto == PROTO_BINARY) {
+            outbuf_puts(&b->out, "@binary\n");
+        } else if (proto == PROTO_DELTA) {
+            outbuf_puts(&b->out, "@delta\n");
+        }
+        if (bot_flush(id) < 0) {
+            return;
+        }
+    } else if ((events & EPOLLOUT) && bot_flush(id) < 0) {
+        return;
+    }
+    if (!(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+        return;
+    }
+    for (;;) {
+        int n = linebuf_fill(&b->in);
+        if (n == 0) {
+            bot_close(id, &stats.closed);
+            return;
+        }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            if (errno != ENOBUFS) {
+                bot_close(id, &stats.resets);
+                return;
+            }
+        }
+        if (bot_input(id) < 0) {
+            return;
+        }
+    }
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t percentile(double p) {
+    if (lat_len == 0) {
+        return 0;
+    }
+    size_t i = (size_t)(p / 100.0 * (double)(lat_len - 1) + 0.5);
+    return lat[i];
+}
+
+static void print_report(double elapsed) {
+    printf("Connections: %llu opened, %llu joined, %llu reconnects, %llu quit after %d turns\n",
+           stats.connects, stats.joined, stats.reconnects, stats.quits, quit_turns);
+    printf("Turns: %llu in %.1f s (%.1f turns/s), %llu wins\n", stats.turns, elapsed,
+           elapsed > 0 ? (double)stats.turns / elapsed : 0.0, stats.wins);
+    qsort(lat, lat_len, sizeof(uint32_t), cmp_u32);
+    printf("Turn latency (us): p50 %u, p90 %u, p99 %u, p99.9 %u, max %u\n", percentile(50), percentile(90),
+           percentile(99), percentile(99.9), lat_len ? lat[lat_len - 1] : 0);
+    printf("Errors: %llu connect, %llu closed by server, %llu reset, %llu bad frames\n",
+           stats.connect_errors, stats.closed, stats.resets, stats.bad_frames);
+}
+
+/* Room for one socket per bot plus some. */
+static void raise_fd_limit(int want) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur >= (rlim_t)want) {
+        return;
+    }
+    rl.rlim_cur = rl.rlim_max == RLIM_INFINITY || rl.rlim_max > (rlim_t)want ? (rlim_t)want : rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-n bots] [-a rate] [-k ms] [-d seconds] [-P proto] [-q turns] [-R ms] [-H host] [-p port]\n",
+            prog);
+    fprintf(stderr, "  -n bots      concurrent players (default 100)\n");
+    fprintf(stderr, "  -a rate      new connections per second (default 0: all at once)\n");
+    fprintf(stderr, "  -k ms        think time before each roll (default 0)\n");
+    fprintf(stderr, "  -d seconds   run time (default 10)\n");
+    fprintf(stderr, "  -P proto     text, delta or binary (default binary)\n");
+    fprintf(stderr, "  -q turns     leave after this many own turns (default: stay)\n");
+    fprintf(stderr, "  -R ms        reconnect this long after a bot is closed (default: no)\n");
+    fprintf(stderr, "  -H host      server address (default 127.0.0.1)\n");
+    fprintf(stderr, "  -p port      server port (default 5555)\n");
+}
+
+int main(int argc, char **argv) {
+    const char *host = "127.0.0.1";
+    int port = PORT;
+    double rate = 0;
+    double duration = 10;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:a:k:d:P:q:R:H:p:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            bot_count = atoi(optarg);
+            break;
+        case 'a':
+            rate = atof(optarg);
+            break;
+        case 'k':
+            think_us = (long long)(atof(optarg) * 1000.0);
+            break;
+        case 'd':
+            duration = atof(optarg);
+            break;
+        case 'P':
+            if (strcmp(optarg, "text") == 0) {
+                proto = PROTO_TEXT;
+            } else if (strcmp(optarg, "delta") == 0) {
+                proto = PROTO_DELTA;
+            } else if (strcmp(optarg, "binary") == 0) {
+                proto = PROTO_BINARY;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'q':
+            quit_turns = atoi(optarg);
+            break;
+        case 'R':
+            reconnect_us = (long long)(atof(optarg) * 1000.0);
+            break;
+        case 'H':
+            host = optarg;
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (bot_count < 1 || duration <= 0 || think_us < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, host, &server_addr.sin_addr) != 1) {
+        fprintf(stderr, "Bad address: %s\n", host);
+        return 1;
+    }
+
+    raise_fd_limit(bot_count + 64);
+    signal(SIGINT, handle_sigint);
+    signal(SIGPIPE, SIG_IGN);
+
+    bots = calloc((size_t)bot_count, sizeof(Bot));
+    epfd = epoll_create1(0);
+    if (!bots || epfd < 0 || queue_init(&think_q, (size_t)bot_count) != 0 ||
+        queue_init(&connect_q, (size_t)bot_count) != 0) {
+        perror("snl-loadgen");
+        return 1;
+    }
+    for (int i = 0; i < bot_count; i++) {
+        bots[i].fd = -1;
+    }
+
+    char arrival[32];
+    if (rate > 0) {
+        snprintf(arrival, sizeof(arrival), "%.0f/s", rate);
+    } else {
+        snprintf(arrival, sizeof(arrival), "all at once");
+    }
+    printf("snl-loadgen: %d bots -> %s:%d, %s, arrival %s, think %.1f ms, %.1f s\n", bot_count, host, port,
+           proto_name[proto], arrival, (double)think_us / 1000.0, duration);
+    fflush(stdout);
+
+    long long start = now_us();
+    long long end = start + (long long)(duration * 1e6);
+    int launched = 0;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (running) {
+        long long now = now_us();
+        if (now >= end) {
+            break;
+        }
+
+        /* New bots on the arrival schedule, then reconnects, then due rolls. */
+        while (launched < bot_count &&
+               (rate <= 0 || now >= start + (long long)((double)launched * 1e6 / rate))) {
+            bot_connect(launched++);
+        }
+        int id;
+        while ((id = queue_pop_due(&connect_q, now)) >= 0) {
+            if (bots[id].state == BOT_IDLE) {
+                stats.reconnects++;
+                bot_connect(id);
+            }
+        }
+        while ((id = queue_pop_due(&think_q, now)) >= 0) {
+            Bot *b = &bots[id];
+            b->queued = 0;
+            if (b->state != BOT_THINKING) {
+                continue;
+            }
+            if (b->due > now) {
+                /* Left over from an earlier session: wait for the new due time. */
+                b->queued = 1;
+                queue_push(&think_q, id, b->due);
+                continue;
+            }
+            bot_roll(id);
+        }
+
+        /* Sleep until the next thing on the schedule. */
+        long long next = end;
+        if (launched < bot_count && rate > 0) {
+            long long t = start + (long long)((double)launched * 1e6 / rate);
+            next = t < next ? t : next;
+        }
+        if (connect_q.len > 0 && connect_q.when[connect_q.head] < next) {
+            next = connect_q.when[connect_q.head];
+        }
+        if (think_q.len > 0 && think_q.when[think_q.head] < next) {
+            next = think_q.when[think_q.head];
+        }
+        long long wait_us = next - now_us();
+        int timeout = wait_us <= 0 ? 0 : (int)((wait_us + 999) / 1000);
+
+        int n = epoll_wait(epfd, events, MAX_EVENTS, timeout);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            bot_event((int)events[i].data.u32, events[i].events);
+        }
+    }
+
+    double elapsed = (double)(now_us() - start) / 1e6;
+    print_report(elapsed);
+    for (int i = 0; i < bot_count; i++) {
+        if (bots[i].fd >= 0) {
+            close(bots[i].fd);
+            outbuf_free(&bots[i].out);
+        }
+    }
+    free(bots);
+    free(lat);
+    close(epfd);
+    return stats.connect_errors || stats.resets || stats.bad_frames ? 1 : 0;
+}
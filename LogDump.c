@@ -0,0 +1,232 @@
+/*
+snl-logdump: turn the binary game.log back into text lines or JSON.
+
+Usage: snl-logdump [-j] [-T] [file]
+  -j  one JSON object per event
+  -T  prefix text lines with the event time
+The file defaults to game.log.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "EventLog.h"
+
+#define DUMP_MAX_SEATS 16
+
+/* Player names seen in EV_JOIN, per table and seat. */
+static char (*names)[DUMP_MAX_SEATS][EVLOG_NAME_MAX] = NULL;
+static size_t names_tables = 0;
+
+static char *name_slot(uint32_t table, uint8_t seat) {
+    if (seat >= DUMP_MAX_SEATS) {
+        return NULL;
+    }
+    if (table >= names_tables) {
+        size_t want = names_tables ? names_tables : 64;
+        while (want <= table) {
+            want *= 2;
+        }
+        void *grown = realloc(names, want * sizeof(*names));
+        if (!grown) {
+            return NULL;
+        }
+        names = grown;
+        memset(names + names_tables, 0, (want - names_tables) * sizeof(*names));
+        names_tables = want;
+    }
+    return names[table][seat];
+}
+
+static const char *player_name(uint32_t table, uint8_t seat) {
+    char *slot = name_slot(table, seat);
+    return slot ? slot : "";
+}
+
+static void format_time(int64_t ts_ns, char *out, size_t len) {
+    time_t secs = (time_t)(ts_ns / 1000000000LL);
+    struct tm tm;
+    localtime_r(&secs, &tm);
+    size_t n = strftime(out, len, "%Y-%m-%d %H:%M:%S", &tm);
+    snprintf(out + n, len - n, ".%03d", (int)((ts_ns / 1000000) % 1000));
+}
+
+/* The same lines the server used to write to game.log. */
+static void print_text(const GameEvent *ev, int with_time) {
+    char prefix[48] = "";
+    if (with_time) {
+        format_time(ev->ts_ns, prefix, sizeof(prefix) - 2);
+        strcat(prefix, " ");
+    }
+    unsigned table = ev->table + 1;
+    const char *name = player_name(ev->table, ev->seat);
+
+    switch (ev->type) {
+    case EV_SERVER_START:
+        printf("%sServer started on port %d\n", prefix, ev->from);
+        break;
+    case EV_JOIN:
+        printf("%sTable %u: Player %d (%s) connected\n", prefix, table, ev->seat + 1, name);
+        break;
+    case EV_LEAVE:
+        printf("%sTable %u: Player %d (%s) disconnected\n", prefix, table, ev->seat + 1, name);
+        break;
+    case EV_ROUND_START:
+        printf("%sTable %u: New game started (round %u)\n", prefix, table, ev->round_no);
+        break;
+    case EV_TABLE_PAUSED:
+        printf("%sTable %u: waiting for players (round %u paused)\n", prefix, table, ev->round_no);
+        break;
+    case EV_TURN:
+        printf("%sTable %u: Turn -> Player %d (%s)\n", prefix, table, ev->seat + 1,
+               name[0] ? name : "Player");
+        break;
+    case EV_ROLL: {
+        int landed = ev->from + ev->dice;
+        printf("%sTable %u: Player %s rolled %d -> position %d\n", prefix, table, name, ev->dice, ev->to);
+        if (ev->flags & EVF_NO_MOVE) {
+            printf("%sTable %u: Player %s needed exact roll (stayed at %d)\n", prefix, table, name, ev->from);
+        } else if (ev->to < landed) {
+            printf("%sTable %u: Player %s hit a snake (%d -> %d)\n", prefix, table, name, landed, ev->to);
+        } else if (ev->to > landed) {
+            printf("%sTable %u: Player %s climbed a ladder (%d -> %d)\n", prefix, table, name, landed, ev->to);
+        }
+        if (ev->flags & EVF_WON) {
+            printf("%sTable %u: Player %s WON the game\n", prefix, table, name);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void print_json_string(const char *s) {
+    putchar('"');
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if (c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+static const char *type_names[EV_TYPE_COUNT] = {
+    [EV_LOG_START] = "log_start",
+    [EV_SERVER_START] = "server_start",
+    [EV_JOIN] = "join",
+    [EV_LEAVE] = "leave",
+    [EV_ROUND_START] = "round_start",
+    [EV_TABLE_PAUSED] = "table_paused",
+    [EV_TURN] = "turn",
+    [EV_ROLL] = "roll",
+};
+
+static void print_json(const GameEvent *ev) {
+    char when[48];
+    format_time(ev->ts_ns, when, sizeof(when));
+    printf("{\"time\":\"%s\",\"ts_ms\":%lld,\"type\":\"%s\"", when,
+           (long long)(ev->ts_ns / 1000000), type_names[ev->type]);
+
+    if (ev->type == EV_SERVER_START) {
+        printf(",\"port\":%d}\n", ev->from);
+        return;
+    }
+    printf(",\"table\":%u,\"round\":%u", ev->table + 1, ev->round_no);
+    if (ev->type == EV_JOIN || ev->type == EV_LEAVE || ev->type == EV_TURN || ev->type == EV_ROLL) {
+        printf(",\"seat\":%d,\"player\":", ev->seat + 1);
+        print_json_string(player_name(ev->table, ev->seat));
+    }
+    if (ev->type == EV_ROLL) {
+        int landed = ev->from + ev->dice;
+        printf(",\"dice\":%d,\"from\":%d,\"to\":%d", ev->dice, ev->from, ev->to);
+        if (!(ev->flags & EVF_NO_MOVE) && ev->to != landed) {
+            printf(",\"jump\":\"%s\",\"jump_from\":%d", ev->to < landed ? "snake" : "ladder", landed);
+        }
+        printf(",\"exact_miss\":%s,\"won\":%s", (ev->flags & EVF_NO_MOVE) ? "true" : "false",
+               (ev->flags & EVF_WON) ? "true" : "false");
+    }
+    printf("}\n");
+}
+
+int main(int argc, char **argv) {
+    int json = 0;
+    int with_time = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "jTh")) != -1) {
+        switch (opt) {
+        case 'j':
+            json = 1;
+            break;
+        case 'T':
+            with_time = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-j] [-T] [file]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    const char *path = optind < argc ? argv[optind] : "game.log";
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("fstat");
+        return 1;
+    }
+    if (st.st_size == 0) {
+        return 0;
+    }
+    unsigned char *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    close(fd);
+
+    EvlogReader rd;
+    evlog_reader_init(&rd, data, (size_t)st.st_size);
+    GameEvent ev;
+    int rc;
+    unsigned long long count = 0;
+    while ((rc = evlog_next(&rd, &ev)) > 0) {
+        if (ev.type == EV_LOG_START) {
+            continue;
+        }
+        if (ev.type == EV_JOIN) {
+            char *slot = name_slot(ev.table, ev.seat);
+            if (slot) {
+                memcpy(slot, ev.name, EVLOG_NAME_MAX);
+            }
+        }
+        if (json) {
+            print_json(&ev);
+        } else {
+            print_text(&ev, with_time);
+        }
+        count++;
+    }
+    if (rc < 0) {
+        fprintf(stderr, "%s: corrupt record at byte %zu (after %llu events)\n",
+                path, rd.off - EVLOG_RECORD_SIZE, count);
+        return 1;
+    }
+
+    munmap(data, (size_t)st.st_size);
+    return 0;
+}
@@ -0,0 +1,427 @@
+/*
+Markov: exact absorbing-chain analysis of a board (see Markov.h).
+*/
+
+#include "Markov.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Largest envelope the LU will factor (entries, 8 bytes each). */
+#define MARKOV_MAX_ENVELOPE ((size_t)1 << 27)
+
+/* Turns between exact re-counts of the probability still on the board (power of two). */
+#define MARKOV_RECOUNT 64
+
+/* Mass below this is dropped while pushing the distribution (it stays in the tail). */
+#define MARKOV_PRUNE 1e-30
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+/* Square reached from s with roll d (s itself when the roll overshoots). */
+static int step(const Board *b, int s, int d) {
+    int landed = 0;
+    return board_move(b, s, d, &landed);
+}
+
+/*
+ * Skyline storage of A = I - Q for the n = size transient squares. Row i keeps
+ * its lower part from column row_first[i], column j its upper part from row
+ * col_first[j]; LU overwrites A in place (L unit lower, U with the diagonal).
+ */
+typedef struct {
+    int n;
+    int *row_first;
+    int *col_first;
+    size_t *row_off;     /* lower(i, c) = low[row_off[i] + c - row_first[i]] */
+    size_t *col_off;     /* upper(r, j) = up[col_off[j] + r - col_first[j]] */
+    double *low;
+    double *up;
+    double *diag;
+} Skyline;
+
+static double *lower_at(Skyline *m, int i, int c) {
+    return &m->low[m->row_off[i] + (size_t)(c - m->row_first[i])];
+}
+
+static double *upper_at(Skyline *m, int r, int j) {
+    return &m->up[m->col_off[j] + (size_t)(r - m->col_first[j])];
+}
+
+static void skyline_free(Skyline *m) {
+    free(m->row_first);
+    free(m->col_first);
+    free(m->row_off);
+    free(m->col_off);
+    free(m->low);
+    free(m->up);
+    free(m->diag);
+}
+
+/* Lay out the envelope of I - Q and fill in its entries. */
+static int skyline_build(Skyline *m, const Board *b, char *err, size_t err_len) {
+    int n = board_size(b);
+    memset(m, 0, sizeof(*m));
+    m->n = n;
+    m->row_first = malloc((size_t)n * sizeof(int));
+    m->col_first = malloc((size_t)n * sizeof(int));
+    m->row_off = malloc(((size_t)n + 1) * sizeof(size_t));
+    m->col_off = malloc(((size_t)n + 1) * sizeof(size_t));
+    m->diag = malloc((size_t)n * sizeof(double));
+    if (!m->row_first || !m->col_first || !m->row_off || !m->col_off || !m->diag) {
+        snprintf(err, err_len, "out of memory for %d states", n);
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        m->row_first[i] = i;
+        m->col_first[i] = i;
+    }
+    for (int s = 0; s < n; s++) {
+        for (int d = 1; d <= 6; d++) {
+            int t = step(b, s, d);
+            if (t >= n) {
+                continue;
+            }
+            if (t < m->row_first[s]) {
+                m->row_first[s] = t;
+            }
+            if (s < m->col_first[t]) {
+                m->col_first[t] = s;
+            }
+        }
+    }
+
+    size_t low_len = 0;
+    size_t up_len = 0;
+    for (int i = 0; i < n; i++) {
+        m->row_off[i] = low_len;
+        m->col_off[i] = up_len;
+        low_len += (size_t)(i - m->row_first[i]);
+        up_len += (size_t)(i - m->col_first[i]);
+    }
+    m->row_off[n] = low_len;
+    m->col_off[n] = up_len;
+    if (low_len + up_len > MARKOV_MAX_ENVELOPE) {
+        snprintf(err, err_len, "skyline envelope of %zu entries is too large to factor", low_len + up_len);
+        return -1;
+    }
+    m->low = calloc(low_len > 0 ? low_len : 1, sizeof(double));
+    m->up = calloc(up_len > 0 ? up_len : 1, sizeof(double));
+    if (!m->low || !m->up) {
+        snprintf(err, err_len, "out of memory for a %zu-entry envelope", low_len + up_len);
+        return -1;
+    }
+
+    for (int s = 0; s < n; s++) {
+        m->diag[s] = 1.0;
+        for (int d = 1; d <= 6; d++) {
+            int t = step(b, s, d);
+            if (t >= n) {
+                continue;
+            }
+            if (t == s) {
+                m->diag[s] -= 1.0 / 6.0;
+            } else if (t < s) {
+                *lower_at(m, s, t) -= 1.0 / 6.0;
+            } else {
+                *upper_at(m, s, t) -= 1.0 / 6.0;
+            }
+        }
+    }
+    return 0;
+}
+
+/* In-place Doolittle LU inside the envelope; -1 (and the row) on a zero pivot. */
+static int skyline_factor(Skyline *m, int *bad_row) {
+    for (int i = 0; i < m->n; i++) {
+        /* Column i of U, top down. */
+        for (int r = m->col_first[i]; r < i; r++) {
+            int lo = m->row_first[r] > m->col_first[i] ? m->row_first[r] : m->col_first[i];
+            double sum = 0.0;
+            for (int k = lo; k < r; k++) {
+                sum += *lower_at(m, r, k) * *upper_at(m, k, i);
+            }
+            *upper_at(m, r, i) -= sum;
+        }
+        /* Row i of L, left to right. */
+        for (int c = m->row_first[i]; c < i; c++) {
+            int lo = m->row_first[i] > m->col_first[c] ? m->row_first[i] : m->col_first[c];
+            double sum = 0.0;
+            for (int k = lo; k < c; k++) {
+                sum += *lower_at(m, i, k) * *upper_at(m, k, c);
+            }
+            *lower_at(m, i, c) = (*lower_at(m, i, c) - sum) / m->diag[c];
+        }
+        int lo = m->row_first[i] > m->col_first[i] ? m->row_first[i] : m->col_first[i];
+        double sum = 0.0;
+        for (int k = lo; k < i; k++) {
+            sum += *lower_at(m, i, k) * *upper_at(m, k, i);
+        }
+        m->diag[i] -= sum;
+        if (fabs(m->diag[i]) < 1e-12) {
+            *bad_row = i;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Solve L U x = x in place. */
+static void skyline_solve(Skyline *m, double *x) {
+    for (int i = 0; i < m->n; i++) {
+        double sum = 0.0;
+        for (int c = m->row_first[i]; c < i; c++) {
+            sum += *lower_at(m, i, c) * x[c];
+        }
+        x[i] -= sum;
+    }
+    for (int j = m->n - 1; j >= 0; j--) {
+        x[j] /= m->diag[j];
+        for (int r = m->col_first[j]; r < j; r++) {
+            x[r] -= *upper_at(m, r, j) * x[j];
+        }
+    }
+}
+
+int markov_expected_turns(const Board *b, double *expected, MarkovStats *st, char *err, size_t err_len) {
+    Skyline m;
+    double start = now_ms();
+    if (skyline_build(&m, b, err, err_len) != 0) {
+        skyline_free(&m);
+        return -1;
+    }
+    int bad_row = -1;
+    if (skyline_factor(&m, &bad_row) != 0) {
+        snprintf(err, err_len, "from square %d the game may never end", bad_row);
+        skyline_free(&m);
+        return -1;
+    }
+    double factored = now_ms();
+
+    for (int i = 0; i < m.n; i++) {
+        expected[i] = 1.0;
+    }
+    expected[m.n] = 0.0;
+    skyline_solve(&m, expected);
+
+    st->states = m.n;
+    st->envelope = m.row_off[m.n] + m.col_off[m.n];
+    st->factor_ms = factored - start;
+    st->solve_ms = now_ms() - factored;
+    skyline_free(&m);
+    return 0;
+}
+
+int markov_min_turns(const Board *b) {
+    int size = board_size(b);
+    int *dist = malloc(((size_t)size + 1) * sizeof(int));
+    int *queue = malloc(((size_t)size + 1) * sizeof(int));
+    if (!dist || !queue) {
+        free(dist);
+        free(queue);
+        return -1;
+    }
+    for (int i = 0; i <= size; i++) {
+        dist[i] = -1;
+    }
+    int head = 0;
+    int tail = 0;
+    dist[0] = 0;
+    queue[tail++] = 0;
+    while (head < tail && dist[size] < 0) {
+        int s = queue[head++];
+        for (int d = 1; d <= 6; d++) {
+            int t = step(b, s, d);
+            if (dist[t] < 0) {
+                dist[t] = dist[s] + 1;
+                queue[tail++] = t;
+            }
+        }
+    }
+    int turns = dist[size];
+    free(dist);
+    free(queue);
+    return turns;
+}
+
+/*
+ * One turn of the distribution: q = p Q over the window [lo, hi] of p.
+ * Away from the jumps a turn is a plain 6-wide moving sum, so it is done
+ * as one (vectorizable) pass, then the mass that landed on jump squares is
+ * moved to their destinations and rolls that overshoot the end stay put.
+ * p and q are offset by 6 zero-padded slots so p[t - 6] is always valid.
+ */
+static double push_turn(const double *restrict p, double *restrict q, int size, int lo, int hi,
+                        const int *jump_from, const int *jump_to, int njumps, double *moved,
+                        int *new_lo, int *new_hi) {
+    int end = hi + 6 < size ? hi + 6 : size;
+    for (int t = lo + 1; t <= end; t++) {
+        q[t] = (p[t - 1] + p[t - 2] + p[t - 3] + p[t - 4] + p[t - 5] + p[t - 6]) * (1.0 / 6.0);
+    }
+    for (int s = size - 5 > lo ? size - 5 : lo; s <= hi; s++) {
+        q[s] += p[s] * (double)(s + 6 - size) * (1.0 / 6.0);
+    }
+
+    int nlo = lo + 1;
+    int nhi = end;
+    if (hi >= size - 5) {
+        nlo = lo;
+    }
+
+    /* Jump squares in (lo, end], found by binary search; gather all first so chains stay one jump. */
+    int first = 0;
+    int last = njumps;
+    while (first < last) {
+        int mid = first + (last - first) / 2;
+        if (jump_from[mid] <= lo) {
+            first = mid + 1;
+        } else {
+            last = mid;
+        }
+    }
+    int stop = first;
+    while (stop < njumps && jump_from[stop] <= end) {
+        moved[stop] = q[jump_from[stop]];
+        q[jump_from[stop]] = 0.0;
+        stop++;
+    }
+    for (int j = first; j < stop; j++) {
+        if (moved[j] == 0.0) {
+            continue;
+        }
+        int to = jump_to[j];
+        q[to] += moved[j];
+        nlo = to < nlo ? to : nlo;
+        nhi = to > nhi ? to : nhi;
+    }
+
+    double absorbed = q[size];
+    q[size] = 0.0;
+    if (nhi >= size) {
+        nhi = size - 1;
+    }
+
+    /* Trim negligible mass off both edges of the window. */
+    while (nlo <= nhi && q[nlo] < MARKOV_PRUNE) {
+        q[nlo++] = 0.0;
+    }
+    while (nhi >= nlo && q[nhi] < MARKOV_PRUNE) {
+        q[nhi--] = 0.0;
+    }
+    *new_lo = nlo;
+    *new_hi = nhi;
+    return absorbed;
+}
+
+double *markov_finish_dist(const Board *b, double tail_eps, int max_turns, int *turns, double *tail) {
+    int size = board_size(b);
+    int njumps = 0;
+    for (int i = 1; i < size; i++) {
+        njumps += step(b, i - 1, 1) != i;
+    }
+    double *pbuf = calloc((size_t)size + 7, sizeof(double));
+    double *qbuf = calloc((size_t)size + 7, sizeof(double));
+    int *jump_from = malloc((size_t)(njumps + 1) * sizeof(int));
+    int *jump_to = malloc((size_t)(njumps + 1) * sizeof(int));
+    double *moved = malloc((size_t)(njumps + 1) * sizeof(double));
+    int cap = 1024;
+    double *f = malloc((size_t)cap * sizeof(double));
+    if (!pbuf || !qbuf || !jump_from || !jump_to || !moved || !f) {
+        free(f);
+        f = NULL;
+        goto out;
+    }
+    njumps = 0;
+    for (int i = 1; i < size; i++) {
+        int to = step(b, i - 1, 1);
+        if (to != i) {
+            jump_from[njumps] = i;
+            jump_to[njumps] = to;
+            njumps++;
+        }
+    }
+
+    /* Everyone starts off the board, on square 0. */
+    double *p = pbuf + 6;
+    double *q = qbuf + 6;
+    p[0] = 1.0;
+    f[0] = 0.0;
+    int lo = 0;
+    int hi = 0;
+    double left = 1.0;
+    int k = 1;
+    while (left > tail_eps && k < max_turns && lo <= hi) {
+        if (k == cap) {
+            double *grown = realloc(f, (size_t)cap * 2 * sizeof(double));
+            if (!grown) {
+                break;
+            }
+            f = grown;
+            cap *= 2;
+        }
+        int nlo;
+        int nhi;
+        f[k] = push_turn(p, q, size, lo, hi, jump_from, jump_to, njumps, moved, &nlo, &nhi);
+        left -= f[k];
+        k++;
+
+        /* 1 - sum(f) drifts over a long run; re-count what is still on the board. */
+        if ((k & (MARKOV_RECOUNT - 1)) == 0) {
+            left = 0.0;
+            for (int s = nlo; s <= nhi; s++) {
+                left += q[s];
+            }
+        }
+
+        /* q becomes p; clear the old p for the next turn. */
+        memset(p + lo, 0, (size_t)(hi - lo + 1) * sizeof(double));
+        double *tmp = p;
+        p = q;
+        q = tmp;
+        lo = nlo;
+        hi = nhi;
+    }
+    *turns = k;
+    *tail = left > 0.0 ? left : 0.0;
+
+out:
+    free(pbuf);
+    free(qbuf);
+    free(jump_from);
+    free(jump_to);
+    free(moved);
+    return f;
+}
+
+void markov_seats(const double *f, int turns, int players, double *win, double *game_len) {
+    for (int s = 0; s < players; s++) {
+        win[s] = 0.0;
+    }
+    memset(game_len, 0, ((size_t)turns * (size_t)players + 1) * sizeof(double));
+
+    /*
+     * Seat s wins on its k-th turn if it finishes then, the seats before it
+     * have not finished after k turns and the seats after it after k - 1.
+     */
+    double surv_prev = 1.0;   /* P(T > k - 1) */
+    for (int k = 1; k < turns; k++) {
+        double surv = surv_prev - f[k];
+        if (surv < 0.0) {
+            surv = 0.0;
+        }
+        for (int s = 0; s < players; s++) {
+            double pr = f[k] * pow(surv, s) * pow(surv_prev, players - 1 - s);
+            win[s] += pr;
+            game_len[(size_t)(k - 1) * (size_t)players + (size_t)s + 1] += pr;
+        }
+        surv_prev = surv;
+    }
+}
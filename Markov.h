@@ -0,0 +1,55 @@
+/*
+Markov: exact analysis of a board as an absorbing Markov chain.
+
+One player's position is the chain: square s moves to board_move(s, d) for
+d = 1..6 with probability 1/6 each, and the last square absorbs. Since seats
+never interact, N-player results follow from one player's distribution of
+turns to finish.
+
+- Expected turns from every square solve (I - Q) E = 1. Normal moves only
+  go forward and reach 6 squares ahead, so the matrix is banded apart from
+  the jumps; it is factored with a skyline (profile) LU whose envelope only
+  widens at snakes and ladders, so fill-in stays inside that envelope.
+- The distribution of turns to finish is pushed forward one turn at a time
+  over the squares that still hold probability.
+*/
+
+#ifndef MARKOV_H
+#define MARKOV_H
+
+#include <stddef.h>
+
+#include "Board.h"
+
+typedef struct {
+    int states;            /* transient squares (0 .. size - 1) */
+    size_t envelope;       /* off-diagonal entries kept by the skyline LU */
+    double factor_ms;
+    double solve_ms;
+} MarkovStats;
+
+/*
+ * Expected turns to finish from every square into expected[0 .. size].
+ * Returns 0, or -1 with a reason in err (the game can get stuck forever,
+ * or the envelope is too big to factor).
+ */
+int markov_expected_turns(const Board *b, double *expected, MarkovStats *st, char *err, size_t err_len);
+
+/* Fewest turns one player can finish in (breadth-first search), or -1 if never. */
+int markov_min_turns(const Board *b);
+
+/*
+ * P(one player finishes on exactly their k-th turn) for k = 0 .. *turns - 1,
+ * pushed until less than tail_eps of the probability is left (or max_turns).
+ * Returns a malloc'd array, or NULL; *tail gets the mass not accounted for.
+ */
+double *markov_finish_dist(const Board *b, double tail_eps, int max_turns, int *turns, double *tail);
+
+/*
+ * From one player's finish distribution f[0 .. turns - 1], the N-player
+ * game: win[seat] and game_len[L] = P(the game ends on overall turn L),
+ * L = 0 .. turns * players (game_len must hold that many + 1 entries).
+ */
+void markov_seats(const double *f, int turns, int players, double *win, double *game_len);
+
+#endif
@@ -0,0 +1,125 @@
+/*
+Metrics: shared-memory histograms and their Prometheus text (see Metrics.h).
+*/
+
+#include "Metrics.h"
+
+#define HIST_HALF (1u << (HIST_SUB_BITS - 1))
+#define PROM_LE_FIRST 10   /* 2^10 ns */
+#define PROM_LE_LAST 35    /* 2^35 ns */
+
+const char *const turn_phase_name[PHASE_COUNT] = {"wake", "think", "result", "sched"};
+
+static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+/*
+ * Below 2^HIST_SUB_BITS a value is its own bucket. Above, the top
+ * HIST_SUB_BITS bits pick one of HIST_HALF buckets in the value's octave.
+ */
+static unsigned hist_index(unsigned long long v) {
+    if (v < (1u << HIST_SUB_BITS)) {
+        return (unsigned)v;
+    }
+    unsigned e = (unsigned)(63 - __builtin_clzll(v)) - (HIST_SUB_BITS - 1);
+    return e * HIST_HALF + (unsigned)(v >> e);
+}
+
+/* Largest value that lands in bucket b. */
+static unsigned long long hist_upper(unsigned b) {
+    if (b < (1u << HIST_SUB_BITS)) {
+        return b;
+    }
+    unsigned e = b / HIST_HALF - 1;
+    unsigned long long m = b - e * HIST_HALF;
+    return ((m + 1) << e) - 1;
+}
+
+void hist_record(Histogram *h, long long value) {
+    unsigned long long v = value > 0 ? (unsigned long long)value : 0;
+    __atomic_fetch_add(&h->buckets[hist_index(v)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum, v, __ATOMIC_RELAXED);
+    unsigned long long max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    while (v > max && !__atomic_compare_exchange_n(&h->max, &max, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+unsigned long long hist_quantile(const Histogram *h, double q) {
+    unsigned long long count = __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+    if (count == 0) {
+        return 0;
+    }
+    unsigned long long want = (unsigned long long)(q * (double)count + 0.5);
+    if (want < 1) {
+        want = 1;
+    }
+    unsigned long long seen = 0;
+    for (unsigned b = 0; b < HIST_BUCKETS; b++) {
+        seen += __atomic_load_n(&h->buckets[b], __ATOMIC_RELAXED);
+        if (seen >= want) {
+            unsigned long long upper = hist_upper(b);
+            unsigned long long max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+            return upper < max ? upper : max;
+        }
+    }
+    return __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+}
+
+static void hist_add(Histogram *into, const Histogram *from) {
+    into->count += __atomic_load_n(&from->count, __ATOMIC_RELAXED);
+    into->sum += __atomic_load_n(&from->sum, __ATOMIC_RELAXED);
+    unsigned long long max = __atomic_load_n(&from->max, __ATOMIC_RELAXED);
+    if (max > into->max) {
+        into->max = max;
+    }
+    for (unsigned b = 0; b < HIST_BUCKETS; b++) {
+        into->buckets[b] += __atomic_load_n(&from->buckets[b], __ATOMIC_RELAXED);
+    }
+}
+
+void metrics_add(Metrics *into, const Metrics *from) {
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        hist_add(&into->phase[p], &from->phase[p]);
+    }
+    hist_add(&into->round_start, &from->round_start);
+    into->turns += __atomic_load_n(&from->turns, __ATOMIC_RELAXED);
+    into->wins += __atomic_load_n(&from->wins, __ATOMIC_RELAXED);
+    into->disconnects += __atomic_load_n(&from->disconnects, __ATOMIC_RELAXED);
+    into->timeouts += __atomic_load_n(&from->timeouts, __ATOMIC_RELAXED);
+    into->idle_drops += __atomic_load_n(&from->idle_drops, __ATOMIC_RELAXED);
+}
+
+void metrics_write_histogram(OutBuf *out, const char *name, const char *label, const Histogram *h) {
+    const char *sep = label[0] ? "," : "";
+    unsigned long long seen = 0;
+    unsigned b = 0;
+    for (int k = PROM_LE_FIRST; k <= PROM_LE_LAST; k++) {
+        /* 2^k is a bucket boundary, so the count below it is exact. */
+        unsigned long long le = 1ULL << k;
+        while (b < HIST_BUCKETS && hist_upper(b) < le) {
+            seen += __atomic_load_n(&h->buckets[b], __ATOMIC_RELAXED);
+            b++;
+        }
+        outbuf_printf(out, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, label, sep, (double)le / 1e9, seen);
+    }
+    /* Count can run ahead of the buckets mid-record; keep +Inf >= the last bucket. */
+    unsigned long long count = __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+    for (; b < HIST_BUCKETS; b++) {
+        seen += __atomic_load_n(&h->buckets[b], __ATOMIC_RELAXED);
+    }
+    if (count < seen) {
+        count = seen;
+    }
+    outbuf_printf(out, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, label, sep, count);
+    outbuf_printf(out, "%s_sum{%s} %.9f\n", name, label,
+                  (double)__atomic_load_n(&h->sum, __ATOMIC_RELAXED) / 1e9);
+    outbuf_printf(out, "%s_count{%s} %llu\n", name, label, count);
+}
+
+void metrics_write_quantiles(OutBuf *out, const char *name, const char *label, const Histogram *h) {
+    const char *sep = label[0] ? "," : "";
+    for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++) {
+        outbuf_printf(out, "%s{%s%squantile=\"%g\"} %.9f\n", name, label, sep, quantiles[i],
+                      (double)hist_quantile(h, quantiles[i]) / 1e9);
+    }
+}
@@ -0,0 +1,79 @@
+/*
+Metrics: latency histograms and counters the server keeps in shared memory,
+and their Prometheus text exposition.
+
+A Histogram is HDR-style: exact below 64, then 32 log-linear buckets per
+power of two, so any recorded value is known to within about 3% whatever
+its size, from nanoseconds to years, in a fixed 15 KB.
+Recording is a few relaxed atomic adds, so any thread of any process can
+record into the shared copy without a lock; a reader sees a snapshot that
+may be a few samples behind, which is all a scrape needs. Threads that would
+otherwise fight over the shared copy's cache lines can each keep their own
+and leave the reader to add them up (metrics_add).
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+#include "NetBuf.h"
+
+#define HIST_SUB_BITS 6
+#define HIST_BUCKETS 1920   /* (64 - HIST_SUB_BITS + 2) * 2^(HIST_SUB_BITS - 1) */
+
+typedef struct {
+    unsigned long long count;
+    unsigned long long sum;
+    unsigned long long max;
+    unsigned long long buckets[HIST_BUCKETS];
+} Histogram;
+
+/* The phases of one turn, in nanoseconds (see README, Metrics). */
+typedef enum {
+    PHASE_WAKE,     /* scheduler's sem_post -> the player's process running */
+    PHASE_THINK,    /* YOUR_TURN sent -> roll received */
+    PHASE_RESULT,   /* roll received -> result sent */
+    PHASE_SCHED,    /* turn done -> scheduler picking it up */
+    PHASE_COUNT
+} TurnPhase;
+
+typedef struct {
+    Histogram phase[PHASE_COUNT];
+    Histogram round_start;          /* table full (or pause over) -> first YOUR_TURN */
+    unsigned long long turns;
+    unsigned long long wins;
+    unsigned long long disconnects;
+    unsigned long long timeouts;    /* turns the server rolled for an idle player */
+    unsigned long long idle_drops;  /* players dropped after too many timeouts in a row */
+} Metrics;
+
+extern const char *const turn_phase_name[PHASE_COUNT];
+
+/* Add one value (negative values count as 0). Lock-free, safe across processes. */
+void hist_record(Histogram *h, long long value);
+
+/* Smallest bucket bound with at least q (0..1) of the samples at or below it; 0 if empty. */
+unsigned long long hist_quantile(const Histogram *h, double q);
+
+/* Fold from into into (a reader's snapshot; from may still be recording). */
+void metrics_add(Metrics *into, const Metrics *from);
+
+/* Relaxed atomic add for the counters. */
+static inline void metrics_count(unsigned long long *counter) {
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Prometheus text samples for one histogram, in seconds: cumulative
+ * <name>_bucket at powers of two from 2^10 ns (1 us) to 2^35 ns (34 s),
+ * then <name>_sum and <name>_count. label is the label set without braces
+ * ("phase=\"think\"", or "" for none). The caller writes the # HELP and
+ * # TYPE lines.
+ */
+void metrics_write_histogram(OutBuf *out, const char *name, const char *label, const Histogram *h);
+
+/* <name>{label,quantile="0.5"} and so on for p50, p90, p99 and p99.9, in seconds. */
+void metrics_write_quantiles(OutBuf *out, const char *name, const char *label, const Histogram *h);
+
+#endif
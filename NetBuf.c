@@ -0,0 +1,179 @@
+/*
+NetBuf: user-space socket buffering shared by the server and the client.
+*/
+
+#include "NetBuf.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+void linebuf_init(LineBuf *lb, int fd) {
+    lb->fd = fd;
+    lb->head = 0;
+    lb->len = 0;
+    lb->recv_calls = 0;
+}
+
+int linebuf_fill(LineBuf *lb) {
+    /* Slide unread bytes to the front so the whole tail is free. */
+    if (lb->head > 0) {
+        memmove(lb->data, lb->data + lb->head, lb->len);
+        lb->head = 0;
+    }
+    if (lb->len == sizeof(lb->data)) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    ssize_t n;
+    do {
+        n = recv(lb->fd, lb->data + lb->len, sizeof(lb->data) - lb->len, 0);
+        lb->recv_calls++;
+    } while (n < 0 && errno == EINTR);
+
+    if (n > 0) {
+        lb->len += (size_t)n;
+    }
+    return (int)n;
+}
+
+int linebuf_pop(LineBuf *lb, char *out, size_t max_len) {
+    const char *start = lb->data + lb->head;
+    const char *nl = memchr(start, '\n', lb->len);
+    size_t take;
+    size_t consumed;
+
+    if (nl) {
+        take = (size_t)(nl - start);
+        consumed = take + 1;
+    } else if (lb->len >= max_len - 1 || lb->len == sizeof(lb->data)) {
+        /* No newline but the caller's buffer (or ours) is full: hand out a chunk. */
+        take = lb->len;
+        consumed = take;
+    } else {
+        return -1;
+    }
+    if (take > max_len - 1) {
+        take = max_len - 1;
+        consumed = take;
+    }
+
+    size_t idx = 0;
+    for (size_t i = 0; i < take; i++) {
+        if (start[i] != '\r') {
+            out[idx++] = start[i];
+        }
+    }
+    out[idx] = '\0';
+
+    lb->head += consumed;
+    lb->len -= consumed;
+    if (lb->len == 0) {
+        lb->head = 0;
+    }
+    return (int)idx;
+}
+
+int linebuf_read_line(LineBuf *lb, char *out, size_t max_len) {
+    for (;;) {
+        int n = linebuf_pop(lb, out, max_len);
+        if (n >= 0) {
+            return n;
+        }
+        if (linebuf_fill(lb) <= 0) {
+            return -1;
+        }
+    }
+}
+
+void outbuf_init(OutBuf *ob, int fd) {
+    ob->fd = fd;
+    ob->data = NULL;
+    ob->off = 0;
+    ob->len = 0;
+    ob->cap = 0;
+    ob->failed = 0;
+    ob->send_calls = 0;
+    ob->send_bytes = 0;
+}
+
+void outbuf_free(OutBuf *ob) {
+    free(ob->data);
+    ob->data = NULL;
+    ob->off = 0;
+    ob->len = 0;
+    ob->cap = 0;
+}
+
+void outbuf_write(OutBuf *ob, const char *data, size_t len) {
+    /* Reclaim the already-sent prefix before growing. */
+    if (ob->off > 0 && ob->len + len > ob->cap) {
+        memmove(ob->data, ob->data + ob->off, ob->len - ob->off);
+        ob->len -= ob->off;
+        ob->off = 0;
+    }
+    if (ob->len + len > ob->cap) {
+        size_t cap = ob->cap ? ob->cap : 1024;
+        while (cap < ob->len + len) {
+            cap *= 2;
+        }
+        char *grown = realloc(ob->data, cap);
+        if (!grown) {
+            ob->failed = 1;
+            return;
+        }
+        ob->data = grown;
+        ob->cap = cap;
+    }
+    memcpy(ob->data + ob->len, data, len);
+    ob->len += len;
+}
+
+void outbuf_puts(OutBuf *ob, const char *msg) {
+    outbuf_write(ob, msg, strlen(msg));
+}
+
+void outbuf_printf(OutBuf *ob, const char *fmt, ...) {
+    char line[512];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n <= 0) {
+        return;
+    }
+    if ((size_t)n >= sizeof(line)) {
+        n = (int)sizeof(line) - 1;
+    }
+    outbuf_write(ob, line, (size_t)n);
+}
+
+size_t outbuf_pending(const OutBuf *ob) {
+    return ob->len - ob->off;
+}
+
+int outbuf_flush(OutBuf *ob) {
+    while (ob->off < ob->len) {
+        ssize_t n = send(ob->fd, ob->data + ob->off, ob->len - ob->off, MSG_NOSIGNAL);
+        ob->send_calls++;
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 1;
+            }
+            return -1;
+        }
+        ob->off += (size_t)n;
+        ob->send_bytes += (unsigned long long)n;
+    }
+    ob->off = 0;
+    ob->len = 0;
+    return 0;
+}
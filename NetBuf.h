@@ -0,0 +1,66 @@
+/*
+NetBuf: user-space socket buffering shared by the server and the client.
+*/
+
+#ifndef NETBUF_H
+#define NETBUF_H
+
+#include <stddef.h>
+
+#define LINEBUF_SIZE 4096
+
+/* Read side: bulk recv() into a buffer, then split lines in user space. */
+typedef struct {
+    int fd;
+    size_t head;   /* first unread byte */
+    size_t len;    /* unread bytes starting at head */
+    unsigned long recv_calls;
+    char data[LINEBUF_SIZE];
+} LineBuf;
+
+void linebuf_init(LineBuf *lb, int fd);
+
+/* One recv() into the free space: >0 bytes read, 0 on EOF, -1 on error (errno set). */
+int linebuf_fill(LineBuf *lb);
+
+/*
+ * Take the next complete line out of the buffer (newline and '\r' stripped).
+ * Returns its length, or -1 if no full line is buffered yet. Lines longer than
+ * max_len - 1 are split, like the old byte-at-a-time reader did.
+ */
+int linebuf_pop(LineBuf *lb, char *out, size_t max_len);
+
+/* Blocking read of one line: length, or -1 on EOF/error. */
+int linebuf_read_line(LineBuf *lb, char *out, size_t max_len);
+
+/*
+ * Write side: messages are appended to one contiguous buffer and leave in a
+ * single send() when the caller flushes, so a whole turn is one syscall.
+ */
+typedef struct {
+    int fd;
+    char *data;
+    size_t off;    /* bytes already sent */
+    size_t len;    /* bytes queued (including sent ones) */
+    size_t cap;
+    int failed;    /* allocation failed; output was dropped */
+    unsigned long send_calls;
+    unsigned long long send_bytes;
+} OutBuf;
+
+void outbuf_init(OutBuf *ob, int fd);
+void outbuf_free(OutBuf *ob);
+void outbuf_write(OutBuf *ob, const char *data, size_t len);
+void outbuf_puts(OutBuf *ob, const char *msg);
+void outbuf_printf(OutBuf *ob, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/* Bytes still waiting to go out. */
+size_t outbuf_pending(const OutBuf *ob);
+
+/*
+ * Send what is queued: 0 when everything went out, 1 when a non-blocking
+ * socket is full (the rest stays queued), -1 on a socket error.
+ */
+int outbuf_flush(OutBuf *ob);
+
+#endif
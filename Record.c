@@ -0,0 +1,90 @@
+/*
+Record: games.rec reader (see Record.h).
+*/
+
+#include "Record.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+long long rec_scan(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return -1;
+    }
+    long long size = (long long)st.st_size;
+    if (size == 0) {
+        return 0;
+    }
+    RecFileHeader fh;
+    if (pread(fd, &fh, sizeof(fh), 0) != (ssize_t)sizeof(fh) ||
+        fh.magic != REC_FILE_MAGIC || fh.version != REC_VERSION) {
+        return -1;
+    }
+    long long off = (long long)sizeof(fh);
+    RecHeader h;
+    while (size - off >= (long long)sizeof(h)) {
+        if (pread(fd, &h, sizeof(h), (off_t)off) != (ssize_t)sizeof(h) ||
+            h.magic != REC_MAGIC || h.bytes < sizeof(h) || (long long)h.bytes > size - off) {
+            break;
+        }
+        off += h.bytes;
+    }
+    return off;
+}
+
+int rec_reader_init(RecReader *r, const unsigned char *data, size_t len) {
+    RecFileHeader fh;
+    if (len < sizeof(fh)) {
+        return -1;
+    }
+    memcpy(&fh, data, sizeof(fh));
+    if (fh.magic != REC_FILE_MAGIC || fh.version != REC_VERSION) {
+        return -1;
+    }
+    r->data = data;
+    r->len = len;
+    r->off = sizeof(fh);
+    return 0;
+}
+
+int rec_next(RecReader *r, RecEntry *e) {
+    if (r->len - r->off < sizeof(RecHeader)) {
+        return 0;
+    }
+    const unsigned char *p = r->data + r->off;
+    memcpy(&e->hdr, p, sizeof(RecHeader));
+    const RecHeader *h = &e->hdr;
+    if (h->magic != REC_MAGIC || h->bytes < sizeof(RecHeader) || h->seats > REC_MAX_SEATS) {
+        return -1;
+    }
+    if (h->bytes > r->len - r->off) {
+        /* Torn write at the end of the file. */
+        return 0;
+    }
+
+    const unsigned char *end = p + h->bytes;
+    const unsigned char *q = p + sizeof(RecHeader);
+    memset(e->names, 0, sizeof(e->names));
+    memset(e->name_len, 0, sizeof(e->name_len));
+    for (int i = 0; i < h->seats; i++) {
+        if (end - q < 2) {
+            return -1;
+        }
+        int seat = q[0];
+        int len = q[1];
+        if (seat >= REC_MAX_SEATS || len > REC_NAME_MAX || end - q - 2 < len) {
+            return -1;
+        }
+        e->names[seat] = (const char *)q + 2;
+        e->name_len[seat] = (uint8_t)len;
+        q += 2 + len;
+    }
+    if ((size_t)(end - q) != h->turns) {
+        return -1;
+    }
+    e->turns = q;
+    r->off += h->bytes;
+    return 1;
+}
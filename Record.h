@@ -0,0 +1,102 @@
+/*
+Record: the games.rec recording format, shared by the server and snl-replay.
+
+Every round is recorded in full, apart from game.log (whose events may be
+dropped when the log ring is full): the server buffers a table's rolls in
+shared memory and appends whole records with one write, under the table
+lock. A record carries the dice seed, the board id, the table's dice state
+before its first roll and one byte per turn; the last record of a round also
+has the outcome and the players' names in seat (join) order. A round longer
+than REC_CHUNK turns is split into several records with increasing part
+numbers, all for the same table and round.
+
+Turn bytes:
+    0sss0ddd   seat s rolled d (1..6)
+    1000 0sss  seat s left the table
+
+The file is a RecFileHeader followed by records, host byte order. A torn
+record at the end (crash mid-write) is ignored by the reader.
+*/
+
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define REC_FILE_MAGIC 0x524C4E53u   /* "SNLR" */
+#define REC_MAGIC 0x47524E53u        /* "SNRG" */
+#define REC_VERSION 1
+#define REC_CHUNK 1024               /* turns buffered per table before a flush */
+#define REC_NAME_MAX 32
+#define REC_MAX_SEATS 8
+
+#define REC_ROLL(seat, dice) ((uint8_t)(((seat) << 3) | (dice)))
+#define REC_LEAVE(seat) ((uint8_t)(0x80 | (seat)))
+#define REC_IS_LEAVE(b) (((b) & 0x80) != 0)
+#define REC_SEAT(b) (REC_IS_LEAVE(b) ? (b) & 0x07 : ((b) >> 3) & 0x07)
+#define REC_DICE(b) ((b) & 0x07)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} RecFileHeader;
+
+typedef enum {
+    REC_MORE = 0,       /* the round goes on in the next part */
+    REC_WON,            /* winner finished on the last turn */
+    REC_ABORTED,        /* too many players left */
+    REC_UNFINISHED      /* server stopped mid-round */
+} RecOutcome;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t bytes;        /* whole record: header, names and turns */
+    uint8_t outcome;       /* RecOutcome */
+    uint8_t winner;        /* seat, REC_WON only */
+    uint8_t seats;         /* name entries that follow (last part only) */
+    uint8_t reserved;
+    uint32_t table;
+    uint32_t round_no;
+    uint32_t part;
+    uint32_t turns;        /* turn bytes in this record */
+    uint32_t reserved2;
+    uint64_t seed;         /* the server's dice seed */
+    uint64_t board_id;
+    uint64_t dice[4];      /* table's dice state before this record's first roll */
+} RecHeader;
+
+/*
+ * After the header, for each of `seats` seats: uint8 seat, uint8 length,
+ * then the name bytes. Then `turns` turn bytes.
+ */
+
+/* Sequential reader over a whole recording in memory. */
+typedef struct {
+    const unsigned char *data;
+    size_t len;
+    size_t off;
+} RecReader;
+
+/* A decoded record; pointers point into the reader's buffer. */
+typedef struct {
+    RecHeader hdr;
+    const char *names[REC_MAX_SEATS];   /* by seat, NULL if absent */
+    uint8_t name_len[REC_MAX_SEATS];
+    const uint8_t *turns;
+} RecEntry;
+
+/*
+ * Length of the whole-record prefix of an open recording (header by header,
+ * with pread), so a writer can cut off a torn record before appending.
+ * 0 for an empty file, -1 if the file is not a recording.
+ */
+long long rec_scan(int fd);
+
+/* Check the file header; 0, or -1 if this is not a recording. */
+int rec_reader_init(RecReader *r, const unsigned char *data, size_t len);
+
+/* Next record: 1, 0 at the end, -1 on a corrupt record. */
+int rec_next(RecReader *r, RecEntry *e);
+
+#endif
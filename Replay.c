@@ -0,0 +1,319 @@
+/*
+snl-replay: push games.rec back through the turn logic, without sockets.
+
+Usage: snl-replay [-b board] [-n passes] [-g table:round] [file]
+  -b board         board file the games were played on (default: built-in)
+  -n passes        replay the whole file this many times (for benchmarking)
+  -g table:round   print one round turn by turn, as snl-logdump would
+The file defaults to games.rec.
+
+Every roll goes through board_turn, the same move code the server uses, and
+every record is checked: its board id against the board, each roll against
+the table's dice stream regenerated from the recorded state, the parts of a
+round for gaps, and the winner against who actually reached the last square
+first. Throughput is printed, so a replay doubles as a regression benchmark
+for the move path.
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Board.h"
+#include "Dice.h"
+#include "Record.h"
+
+/* Per-table state while replaying. */
+typedef struct {
+    uint32_t round_no;
+    uint32_t next_part;
+    int live;                   /* a round is in progress */
+    int winner;                 /* seat that reached the last square, -1 = none yet */
+    int pos[REC_MAX_SEATS];
+} ReplayTable;
+
+typedef struct {
+    unsigned long long records;
+    unsigned long long rounds;
+    unsigned long long won;
+    unsigned long long aborted;
+    unsigned long long unfinished;
+    unsigned long long turns;
+    unsigned long long leaves;
+    unsigned long long board_mismatch;
+    unsigned long long dice_mismatch;
+    unsigned long long winner_mismatch;
+    unsigned long long gaps;
+} ReplayStats;
+
+static ReplayTable *tables = NULL;
+static size_t table_cap = 0;
+
+static ReplayTable *table_state(uint32_t table) {
+    if (table >= table_cap) {
+        size_t cap = table_cap ? table_cap : 64;
+        while (cap <= table) {
+            cap *= 2;
+        }
+        ReplayTable *grown = realloc(tables, cap * sizeof(ReplayTable));
+        if (!grown) {
+            return NULL;
+        }
+        memset(grown + table_cap, 0, (cap - table_cap) * sizeof(ReplayTable));
+        tables = grown;
+        table_cap = cap;
+    }
+    return &tables[table];
+}
+
+/* The round to print with -g (1-based table, as players see it). */
+static int show_table = -1;
+static uint32_t show_round = 0;
+static char show_names[REC_MAX_SEATS][REC_NAME_MAX + 1];
+
+static int showing(const RecHeader *h) {
+    return show_table >= 0 && h->table == (uint32_t)show_table && h->round_no == show_round;
+}
+
+static void show_turn(const RecHeader *h, int seat, const TurnResult *r) {
+    const char *name = show_names[seat][0] ? show_names[seat] : "?";
+    unsigned table = h->table + 1;
+    int landed = r->before + r->dice;
+    printf("Table %u: Player %s rolled %d -> position %d\n", table, name, r->dice, r->after);
+    if (!r->moved) {
+        printf("Table %u: Player %s needed exact roll (stayed at %d)\n", table, name, r->before);
+    } else if (r->after < landed) {
+        printf("Table %u: Player %s hit a snake (%d -> %d)\n", table, name, landed, r->after);
+    } else if (r->after > landed) {
+        printf("Table %u: Player %s climbed a ladder (%d -> %d)\n", table, name, landed, r->after);
+    }
+    if (r->won) {
+        printf("Table %u: Player %s WON the game\n", table, name);
+    }
+}
+
+/* Replay one record against its table. */
+static void replay_record(const Board *b, uint64_t id, const RecEntry *e, ReplayStats *st) {
+    const RecHeader *h = &e->hdr;
+    ReplayTable *t = table_state(h->table);
+    if (!t) {
+        return;
+    }
+    st->records++;
+    if (h->board_id != id) {
+        st->board_mismatch++;
+    }
+
+    if (h->part == 0) {
+        memset(t->pos, 0, sizeof(t->pos));
+        t->round_no = h->round_no;
+        t->winner = -1;
+        t->live = 1;
+    } else if (!t->live || t->round_no != h->round_no || t->next_part != h->part) {
+        /* A part is missing: nothing after it can be trusted for this round. */
+        st->gaps++;
+        t->live = 0;
+        return;
+    }
+    t->next_part = h->part + 1;
+
+    DiceRng dice;
+    memcpy(dice.s, h->dice, sizeof(dice.s));
+    int show = showing(h);
+    for (uint32_t i = 0; i < h->turns; i++) {
+        uint8_t turn = e->turns[i];
+        int seat = REC_SEAT(turn);
+        if (REC_IS_LEAVE(turn)) {
+            st->leaves++;
+            if (show) {
+                printf("Table %u: Player %s left\n", h->table + 1,
+                       show_names[seat][0] ? show_names[seat] : "?");
+            }
+            continue;
+        }
+        int rolled = REC_DICE(turn);
+        st->dice_mismatch += dice_roll(&dice) != rolled;
+
+        TurnResult r;
+        board_turn(b, &t->pos[seat], rolled, &r);
+        st->turns++;
+        if (r.won) {
+            /* Only the first to arrive wins, and the round must end right there. */
+            if (t->winner >= 0 || h->outcome != REC_WON || i + 1 != h->turns) {
+                st->winner_mismatch++;
+            }
+            if (t->winner < 0) {
+                t->winner = seat;
+            }
+        }
+        if (show) {
+            show_turn(h, seat, &r);
+        }
+    }
+
+    switch (h->outcome) {
+    case REC_MORE:
+        return;
+    case REC_WON:
+        st->won++;
+        if (t->winner != h->winner) {
+            st->winner_mismatch++;
+        }
+        break;
+    case REC_ABORTED:
+        st->aborted++;
+        break;
+    default:
+        st->unfinished++;
+        break;
+    }
+    st->rounds++;
+    t->live = 0;
+}
+
+/* Fill show_names from the last part of the -g round. */
+static void find_show_names(const unsigned char *data, size_t len) {
+    RecReader rd;
+    RecEntry e;
+    if (rec_reader_init(&rd, data, len) != 0) {
+        return;
+    }
+    while (rec_next(&rd, &e) > 0) {
+        if (!showing(&e.hdr) || e.hdr.outcome == REC_MORE) {
+            continue;
+        }
+        for (int s = 0; s < REC_MAX_SEATS; s++) {
+            if (e.names[s]) {
+                memcpy(show_names[s], e.names[s], e.name_len[s]);
+                show_names[s][e.name_len[s]] = '\0';
+            }
+        }
+    }
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-b board] [-n passes] [-g table:round] [file]\n", prog);
+    fprintf(stderr, "  -b board         board file the games were played on (default: built-in)\n");
+    fprintf(stderr, "  -n passes        replay the file this many times (default 1)\n");
+    fprintf(stderr, "  -g table:round   print one round turn by turn\n");
+}
+
+int main(int argc, char **argv) {
+    const char *board_file = NULL;
+    int passes = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:n:g:h")) != -1) {
+        switch (opt) {
+        case 'b':
+            board_file = optarg;
+            break;
+        case 'n':
+            passes = atoi(optarg);
+            break;
+        case 'g': {
+            unsigned table = 0;
+            unsigned round_no = 0;
+            if (sscanf(optarg, "%u:%u", &table, &round_no) != 2 || table < 1) {
+                usage(argv[0]);
+                return 1;
+            }
+            show_table = (int)table - 1;
+            show_round = round_no;
+            break;
+        }
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (passes < 1) {
+        passes = 1;
+    }
+    const char *path = optind < argc ? argv[optind] : "games.rec";
+
+    Board board;
+    board_init_default(&board);
+    if (board_file) {
+        char err[256];
+        if (board_load(&board, board_file, err, sizeof(err)) != 0) {
+            fprintf(stderr, "Bad board: %s\n", err);
+            return 1;
+        }
+    }
+    uint64_t id = board_id(&board);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("fstat");
+        return 1;
+    }
+    size_t len = (size_t)st.st_size;
+    unsigned char *data = len > 0 ? mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    if (len > 0 && data == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    close(fd);
+
+    RecReader rd;
+    if (len == 0 || rec_reader_init(&rd, data, len) != 0) {
+        fprintf(stderr, "%s: not a game recording\n", path);
+        return 1;
+    }
+    if (show_table >= 0) {
+        find_show_names(data, len);
+    }
+
+    ReplayStats total;
+    memset(&total, 0, sizeof(total));
+    int rc = 0;
+    double start = now_s();
+    for (int pass = 0; pass < passes; pass++) {
+        ReplayStats stats;
+        memset(&stats, 0, sizeof(stats));
+        memset(tables, 0, table_cap * sizeof(ReplayTable));
+        rec_reader_init(&rd, data, len);
+        RecEntry e;
+        while ((rc = rec_next(&rd, &e)) > 0) {
+            replay_record(&board, id, &e, &stats);
+        }
+        if (rc < 0) {
+            fprintf(stderr, "%s: corrupt record at byte %zu\n", path, rd.off);
+        }
+        total = stats;
+        show_table = -1;
+    }
+    double elapsed = now_s() - start;
+
+    unsigned long long turns = total.turns * (unsigned long long)passes;
+    printf("snl-replay: %s, %llu records, %llu rounds (%llu won, %llu aborted, %llu unfinished), %llu turns\n",
+           path, total.records, total.rounds, total.won, total.aborted, total.unfinished, total.turns);
+    printf("Time: %.3f s for %d pass%s (%.1f M turns/s)\n", elapsed, passes, passes == 1 ? "" : "es",
+           elapsed > 0 ? (double)turns / elapsed / 1e6 : 0.0);
+    printf("Checks: %llu board id, %llu dice stream, %llu winner mismatches, %llu gaps\n",
+           total.board_mismatch, total.dice_mismatch, total.winner_mismatch, total.gaps);
+
+    munmap(data, len);
+    free(tables);
+    board_free(&board);
+    if (rc < 0 || total.board_mismatch || total.dice_mismatch || total.winner_mismatch || total.gaps) {
+        return 1;
+    }
+    return 0;
+}
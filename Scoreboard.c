@@ -0,0 +1,200 @@
+/*
+Scoreboard: hashed name index plus rank order (see Scoreboard.h).
+*/
+
+#include "Scoreboard.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SB_ALIGN(n) (((n) + 63) & ~(size_t)63)
+
+static unsigned int bucket_count(int cap) {
+    unsigned int n = 16;
+    while (n < (unsigned int)cap) {
+        n <<= 1;
+    }
+    return n;
+}
+
+/* FNV-1a over the name. */
+static uint32_t name_hash(const char *name) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < SB_NAME_MAX && name[i]; i++) {
+        h ^= (unsigned char)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+size_t scoreboard_bytes(int cap) {
+    return SB_ALIGN(sizeof(ScoreboardHeader)) +
+           SB_ALIGN((size_t)cap * sizeof(ScoreEntry)) +
+           SB_ALIGN((size_t)bucket_count(cap) * sizeof(int)) +
+           SB_ALIGN((size_t)cap * sizeof(int));
+}
+
+void scoreboard_attach(Scoreboard *sb, void *mem, int cap, int init) {
+    char *p = mem;
+    sb->hdr = (ScoreboardHeader *)p;
+    p += SB_ALIGN(sizeof(ScoreboardHeader));
+    sb->entries = (ScoreEntry *)p;
+    p += SB_ALIGN((size_t)cap * sizeof(ScoreEntry));
+    sb->buckets = (int *)p;
+    p += SB_ALIGN((size_t)bucket_count(cap) * sizeof(int));
+    sb->order = (int *)p;
+
+    /* Zero-filled memory is an empty board; only the header needs setting. */
+    if (init) {
+        sb->hdr->count = 0;
+        sb->hdr->cap = cap;
+        sb->hdr->bucket_mask = bucket_count(cap) - 1;
+        sb->hdr->full_drops = 0;
+    }
+}
+
+int scoreboard_grow(Scoreboard *sb, int new_cap) {
+    /* The new hash and order may land on the old ones, so keep the order aside. */
+    int n = sb->hdr->count;
+    int *order = malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+    if (!order) {
+        return -1;
+    }
+    memcpy(order, sb->order, (size_t)n * sizeof(int));
+
+    scoreboard_attach(sb, sb->hdr, new_cap, 0);
+    sb->hdr->cap = new_cap;
+    sb->hdr->bucket_mask = bucket_count(new_cap) - 1;
+    memset(sb->buckets, 0, (size_t)bucket_count(new_cap) * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        unsigned int b = name_hash(sb->entries[i].name) & sb->hdr->bucket_mask;
+        sb->entries[i].next = sb->buckets[b];
+        sb->buckets[b] = i + 1;
+    }
+    memcpy(sb->order, order, (size_t)n * sizeof(int));
+    free(order);
+    return 0;
+}
+
+int scoreboard_find(const Scoreboard *sb, const char *name) {
+    int link = sb->buckets[name_hash(name) & sb->hdr->bucket_mask];
+    while (link != 0) {
+        const ScoreEntry *e = &sb->entries[link - 1];
+        if (strncmp(e->name, name, SB_NAME_MAX) == 0) {
+            return link - 1;
+        }
+        link = e->next;
+    }
+    return -1;
+}
+
+/* Find or add a player's entry; a new one goes last in the rank order with 0 wins. */
+static int find_or_add(Scoreboard *sb, const char *name) {
+    int idx = scoreboard_find(sb, name);
+    if (idx >= 0) {
+        return idx;
+    }
+    if (sb->hdr->count >= sb->hdr->cap) {
+        return -1;
+    }
+
+    idx = sb->hdr->count;
+    ScoreEntry *e = &sb->entries[idx];
+    strncpy(e->name, name, SB_NAME_MAX - 1);
+    e->name[SB_NAME_MAX - 1] = '\0';
+    e->wins = 0;
+    e->rank = idx;
+    sb->order[idx] = idx;
+
+    unsigned int b = name_hash(e->name) & sb->hdr->bucket_mask;
+    e->next = sb->buckets[b];
+    sb->buckets[b] = idx + 1;
+    sb->hdr->count++;
+    return idx;
+}
+
+/* First position in the rank order whose entry has at most `wins` wins. */
+static int first_at_most(const Scoreboard *sb, int wins, int hi) {
+    int lo = 0;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (sb->entries[sb->order[mid]].wins > wins) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int scoreboard_win(Scoreboard *sb, const char *name) {
+    int idx = find_or_add(sb, name);
+    if (idx < 0) {
+        sb->hdr->full_drops++;
+        return -1;
+    }
+
+    /*
+     * Swap the entry with the first one of its wins group, then bump it:
+     * everything before that slot has more wins, so the order stays sorted.
+     */
+    ScoreEntry *e = &sb->entries[idx];
+    int pos = e->rank;
+    int front = first_at_most(sb, e->wins, pos);
+    if (front != pos) {
+        int other = sb->order[front];
+        sb->order[front] = idx;
+        sb->order[pos] = other;
+        sb->entries[other].rank = pos;
+        e->rank = front;
+    }
+    e->wins++;
+    return idx;
+}
+
+int scoreboard_put(Scoreboard *sb, const char *name, int wins) {
+    int idx = find_or_add(sb, name);
+    if (idx < 0) {
+        sb->hdr->full_drops++;
+        return -1;
+    }
+    sb->entries[idx].wins += wins;
+    return idx;
+}
+
+static int by_wins(const void *a, const void *b, void *arg) {
+    const ScoreEntry *entries = arg;
+    int ia = *(const int *)a;
+    int ib = *(const int *)b;
+    if (entries[ia].wins != entries[ib].wins) {
+        return entries[ia].wins > entries[ib].wins ? -1 : 1;
+    }
+    return ia < ib ? -1 : (ia > ib);
+}
+
+void scoreboard_sort(Scoreboard *sb) {
+    int n = sb->hdr->count;
+    for (int i = 0; i < n; i++) {
+        sb->order[i] = i;
+    }
+    qsort_r(sb->order, (size_t)n, sizeof(int), by_wins, sb->entries);
+    for (int i = 0; i < n; i++) {
+        sb->entries[sb->order[i]].rank = i;
+    }
+}
+
+int scoreboard_rank(const Scoreboard *sb, int idx) {
+    const ScoreEntry *e = &sb->entries[idx];
+    return first_at_most(sb, e->wins, e->rank) + 1;
+}
+
+int scoreboard_top(const Scoreboard *sb, ScoreEntry *out, int n) {
+    if (n > sb->hdr->count) {
+        n = sb->hdr->count;
+    }
+    for (int i = 0; i < n; i++) {
+        out[i] = sb->entries[sb->order[i]];
+    }
+    return n;
+}
@@ -0,0 +1,75 @@
+/*
+Scoreboard: win counts for every player who ever won, indexed two ways.
+
+- A chained hash on the name finds a player's entry in O(1).
+- A rank order (entry indices sorted by wins, descending) gives top-N as a
+  prefix and a player's rank from their position. A win moves the player to
+  the front of their old wins group with one swap, found by binary search, so
+  an update is O(log n) and the order never needs a full re-sort.
+
+Everything is plain arrays and indices (no pointers), so the whole board can
+live in shared memory and be used from any process that maps it.
+Callers do the locking.
+*/
+
+#ifndef SCOREBOARD_H
+#define SCOREBOARD_H
+
+#include <stddef.h>
+
+#define SB_NAME_MAX 32
+
+typedef struct {
+    char name[SB_NAME_MAX];
+    int wins;
+    int next;   /* hash chain: index + 1 of the next entry, 0 = end */
+    int rank;   /* position of this entry in the rank order */
+} ScoreEntry;
+
+/* Lives at the start of the scoreboard memory. */
+typedef struct {
+    int count;
+    int cap;
+    unsigned int bucket_mask;
+    int full_drops;   /* wins lost because the board was full */
+} ScoreboardHeader;
+
+/* Process-local view of a scoreboard region. */
+typedef struct {
+    ScoreboardHeader *hdr;
+    ScoreEntry *entries;
+    int *buckets;     /* index + 1 of the first entry in the chain, 0 = empty */
+    int *order;       /* entry indices, most wins first */
+} Scoreboard;
+
+/* Bytes needed for a board of cap players. */
+size_t scoreboard_bytes(int cap);
+
+/* Point sb at mem; init = 1 sets up a fresh board in zero-filled memory. */
+void scoreboard_attach(Scoreboard *sb, void *mem, int cap, int init);
+
+/* Entry index of a player, or -1. */
+int scoreboard_find(const Scoreboard *sb, const char *name);
+
+/*
+ * Re-lay the board out for new_cap players, in place: the memory at sb->hdr
+ * must already span scoreboard_bytes(new_cap). Entries keep their indices;
+ * the hash and rank order move to their new offsets. Returns 0, or -1 (out
+ * of memory) with the board unchanged.
+ */
+int scoreboard_grow(Scoreboard *sb, int new_cap);
+
+/* Count one win (adding the player if new); entry index, or -1 if the board is full. */
+int scoreboard_win(Scoreboard *sb, const char *name);
+
+/* Bulk load: add wins without keeping the rank order; call scoreboard_sort after. */
+int scoreboard_put(Scoreboard *sb, const char *name, int wins);
+void scoreboard_sort(Scoreboard *sb);
+
+/* 1-based rank of an entry; ties share the best rank. */
+int scoreboard_rank(const Scoreboard *sb, int idx);
+
+/* Copy up to n best entries into out; returns how many were copied. */
+int scoreboard_top(const Scoreboard *sb, ScoreEntry *out, int n);
+
+#endif
@@ -26,6 +26,7 @@ Amr:
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
@@ -39,218 +40,955 @@ Amr:
 #include <time.h>
 #include <semaphore.h>
 #include <errno.h>
-#include <stdarg.h>
 #include <ctype.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <sched.h>
+
+#include "Board.h"
+#include "Dice.h"
+#include "EventLog.h"
+#include "Metrics.h"
+#include "NetBuf.h"
+#include "Record.h"
+#include "Scoreboard.h"
+#include "TimerWheel.h"
+#include "Wire.h"
 
 #define PORT 5555
+#define WATCH_PORT 5556
 #define MAX_PLAYERS 5
 #define MIN_PLAYERS 3
-#define BOARD_SIZE 100
 #define SHM_NAME "/snl_shm"
+#define SCORE_SHM_NAME "/snl_scores"
 #define SCORE_FILE "scores.txt"
+#define SCORE_JOURNAL "scores.journal"
+#define REC_FILE "games.rec"
+#define LOG_FILE "game.log"
+#define LOG_FILE_OLD "game.log.old"
+#define SCORE_COMPACT_RECORDS 256
+#define SCORE_COMPACT_MS 30000
+#define WIN_QUEUE 256
 #define MAX_NAME 32
-#define LOG_QUEUE_SIZE 64
-#define LOG_MSG_LEN 128
-#define SCORE_MAX 50
+#define DEFAULT_LOG_SLOTS 4096
+#define LOG_BATCH_BYTES 65536
+#define DEFAULT_SCORE_CAP (1 << 16)
+#define SCORE_MAX_CAP (1 << 26)
+#define SCOREBOARD_TOP 10
+#define DEFAULT_TABLES 1024
+#define BOARD_SHOW_ROWS 10
+#define BOARD_TEXT_MAX 4096
+#define DEFAULT_ROUND_PAUSE_MS 2000
+#define DEFAULT_METRICS_SOCKET "metrics.sock"
+#define DEFAULT_TURN_TIMEOUT_MS 30000
+#define DEFAULT_TURN_STRIKES 3
+#define TURN_WHEEL_SLOTS 4096
+#define TURN_WHEEL_TICK_MS 10
+#define TURN_TIMEOUT_POLL_MS 20
+
+/* What a client asked for with its first line. */
+typedef enum {
+    PROTO_TEXT,     /* plain lines, board drawn by the server (telnet) */
+    PROTO_DELTA,    /* "@delta": lines plus @ position updates */
+    PROTO_BINARY,   /* "@binary": Wire.h frames both ways */
+    PROTO_COUNT
+} ClientProto;
 
-/* Persistent score entry (saved to scores.txt). */
+/* Fork mode: one of a table's recent moves, kept so every seat can show it. */
+#define MOVE_HISTORY 8
 typedef struct {
+    int seat;
     char name[MAX_NAME];
-    int wins;
-} ScoreEntry;
+    TurnResult result;
+} MoveRecord;
 
-/* Shared state between parent threads and forked children. */
+/*
+ * One game table: its own seats, positions, turn order and round counter.
+ * Everything except the scheduler link is guarded by the table's own lock.
+ */
 typedef struct {
+    pthread_mutex_t lock;
     int position[MAX_PLAYERS];
     int connected[MAX_PLAYERS];
     int current_turn;
-    int game_started;
+    int game_started;           /* written atomically: matchmaking peeks without the lock */
     int game_over;
     int winner_id;
     int round_no;
     int game_over_notice;
     int turn_count;
     int board_show_every;
-    int target_players;
-    int active_players;
+    unsigned roster_gen;        /* bumped when a player leaves or names themselves */
+    int active_players;         /* written atomically, like game_started */
     char player_name[MAX_PLAYERS][MAX_NAME];
 
-    ScoreEntry scores[SCORE_MAX];
-    int score_count;
+    /* Per-table turn handoff (process-shared). */
+    sem_t turn_sem[MAX_PLAYERS];
+    int turn_finished;          /* set by the player's handler, read by the scheduler */
+    unsigned turn_seq;          /* bumped each time a turn is handed out */
+    long long turn_deadline_ms; /* when the current turn times out (0: no deadline) */
+
+    /* Turn timeouts: auto-rolls in a row per seat, and the last auto-rolled turn. */
+    int strikes[MAX_PLAYERS];
+    unsigned seat_gen[MAX_PLAYERS];     /* bumped when the seat is vacated */
+    TurnResult auto_result;
+    unsigned auto_seq;
 
-    /* Log queue for the async logger thread. */
-    char log_queue[LOG_QUEUE_SIZE][LOG_MSG_LEN];
-    int log_head;
-    int log_tail;
+    /* Fork mode: the last MOVE_HISTORY moves; moves[move_seq % MOVE_HISTORY] is next. */
+    unsigned move_seq;
+    MoveRecord moves[MOVE_HISTORY];
 
-    /* Sync primitives (process-shared). */
-    pthread_mutex_t state_mutex;
-    pthread_mutex_t log_mutex;
-    sem_t log_items;
-    sem_t log_spaces;
-    sem_t turn_sem[MAX_PLAYERS];
-    sem_t turn_done;
+    /* Scheduler ready list link, guarded by sched_mutex (see wake_table_locked). */
+    int queued;
+    int ready_next;
+
+    long long round_started_ns; /* for the start-of-round latency stat */
+    long long turn_signaled_ns; /* scheduler's sem_post, for the wake phase */
+    long long turn_done_ns;     /* turn_finished set after a roll, for the sched phase */
+
+    DiceRng dice;               /* this table's own roll stream (stream = table index) */
+
+    /* Round recording (Record.h): turns since the last flush and the dice state before them. */
+    DiceRng rec_dice;
+    int rec_seats;              /* bitmask of seats in the round */
+    int rec_part;
+    int rec_turns;
+    uint8_t rec_buf[REC_CHUNK];
+} GameTable;
+
+/*
+ * One log ring slot. seq tells whose turn the slot is: == pos when free for the
+ * producer claiming pos, == pos + 1 once that event is published.
+ */
+typedef struct {
+    unsigned long seq;
+    GameEvent ev;
+} LogSlot;
+
+/* A ring of log slots: the shared one in game, plus one per shard when sharded. */
+typedef struct {
+    LogSlot *slots;
+    unsigned long mask;                 /* slot count - 1 (power of two) */
+    unsigned long enqueue_pos;          /* producers claim slots with CAS */
+    unsigned long dequeue_pos;          /* logger thread only */
+} LogRing;
+
+/* Shared state between parent threads and forked children. */
+typedef struct {
+    int target_players;
+    int table_count;
+    unsigned long long recv_calls;
+    unsigned long long send_calls;
+    unsigned long long send_bytes;
+
+    /* games.rec counters (atomic adds). */
+    unsigned long long rec_rounds;
+    unsigned long long rec_records;
+    unsigned long long rec_bytes;
+    unsigned long long rec_errors;
+
+    /*
+     * The scoreboard itself is its own segment (see scores), guarded by
+     * score_mutex. It grows by doubling; its header's cap is the size
+     * every process must have mapped before touching it.
+     */
+
+    /* Wins not yet appended to the score journal (ring, guarded by score_mutex). */
+    char win_queue[WIN_QUEUE][MAX_NAME];
+    int win_head;
+    int win_count;
+    int win_overflow;                   /* queue was full: next compaction covers it */
+
+    /* Log ring for the async logger thread (slots live after the tables). */
+    LogRing log;
+    unsigned long long log_dropped;     /* messages lost because the ring was full */
+
+    /* Sync primitives (process-shared). Lock order: table lock, then sched/score. */
+    pthread_mutex_t score_mutex;
+    sem_t score_dirty;                  /* wakeups for the score writer */
+    sem_t log_items;                    /* wakeups for the logger, not a count */
+
+    /* Tables with something for the scheduler to do, signalled via sched_cond. */
+    pthread_mutex_t sched_mutex;
+    pthread_cond_t sched_cond;
+    int ready_head;
+    int ready_tail;
+
+    /*
+     * Turn phase histograms and counters (Metrics.h), recorded lock-free by
+     * any process. Sharded event threads keep their own (see my_metrics).
+     */
+    Metrics metrics;
+
+    /* Tables live right after the header, table_count of them. */
+    GameTable tables[];
 } SharedGame;
 
 /* Global shared memory pointer. */
 static SharedGame *game = NULL;
+static size_t game_size = 0;
+static Scoreboard scores;
+static char *scores_base = NULL;   /* start of the address range reserved for SCORE_MAX_CAP */
+static int scores_cap = 0;         /* players the part this process has mapped holds */
+static int scores_fd = -1;
 static volatile sig_atomic_t server_running = 1;
+
+/*
+ * Where the calling thread records metrics: a sharded event thread's own
+ * copy, so shards never share those cache lines, or else the shared one.
+ * Readers add them all up (metrics_snapshot).
+ */
+static __thread Metrics *thread_metrics = NULL;
+
+static inline Metrics *my_metrics(void) {
+    return thread_metrics ? thread_metrics : &game->metrics;
+}
+static int event_mode = 0;
+static int round_pause_ms = DEFAULT_ROUND_PAUSE_MS;
+static long long started_ns = 0;
 static int server_fd = -1;
+static int metrics_fd = -1;
+static const char *metrics_path = DEFAULT_METRICS_SOCKET;
+static int turn_timeout_ms = DEFAULT_TURN_TIMEOUT_MS;
+static int turn_strikes = DEFAULT_TURN_STRIKES;
 
-/* Hard-coded snakes and ladders for the board. */
-static int snakes[4][2] = {
-    {99, 54}, {70, 55}, {52, 42}, {25, 2}
-};
+/* The board in play (jump table built once at startup). */
+static Board board;
+static uint64_t board_fingerprint = 0;
 
-static int ladders[4][2] = {
-    {6, 25}, {11, 40}, {46, 90}, {60, 85}
-};
+/* Dice seed of this run and the recording every process appends to. */
+static uint64_t dice_seed_value = 0;
+static int rec_fd = -1;
 
-/* Push a message into the shared log queue (drop if full). */
-static void enqueue_log(const char *fmt, ...) {
-    char msg[LOG_MSG_LEN];
-    va_list args;
-    va_start(args, fmt);
-    vsnprintf(msg, sizeof(msg), fmt, args);
-    va_end(args);
+/* Monotonic clock in nanoseconds. */
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Monotonic clock in milliseconds (for round pauses). */
+static long long now_ms(void) {
+    return now_ns() / 1000000;
+}
+
+/*
+ * Where the calling thread logs: a sharded event thread's own ring (the
+ * logger drains those along with the shared one), or else the shared ring.
+ * Event threads also wake the logger once per loop pass (log_wake) rather
+ * than with a sem_post per event.
+ */
+static __thread LogRing *thread_log = NULL;
+static __thread int log_wake_deferred = 0;
+static __thread int log_wake_pending = 0;
+static LogRing **shard_logs = NULL;   /* published by setup_shards once complete */
+static int shard_log_count = 0;
+
+/*
+ * Timestamp a filled-in event and put it in the calling thread's log ring,
+ * waking the logger; dropped (and counted) if the ring is full. Lock-free:
+ * producers in any process claim a slot by CAS on enqueue_pos. The event is built
+ * by the caller beforehand, so claiming, copying and publishing are a few
+ * instructions in a row: a child that crashes while building an event never
+ * leaves a claimed slot unpublished, which would stall the logger for good.
+ */
+static void log_push(GameEvent *ev) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ev->ts_ns = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
 
-    size_t len = strlen(msg);
-    if (len > 0 && msg[len - 1] == '\n') {
-        msg[len - 1] = '\0';
+    LogRing *ring = thread_log ? thread_log : &game->log;
+    unsigned long pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        LogSlot *slot = &ring->slots[pos & ring->mask];
+        unsigned long seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        long diff = (long)(seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->enqueue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                slot->ev = *ev;
+                __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+                if (log_wake_deferred) {
+                    log_wake_pending = 1;
+                } else {
+                    sem_post(&game->log_items);
+                }
+                return;
+            }
+        } else if (diff < 0) {
+            /* Don't block gameplay on logging. */
+            __atomic_fetch_add(&game->log_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+        }
     }
+}
 
-    /* Don't block gameplay on logging. */
-    if (sem_trywait(&game->log_spaces) != 0) {
-        return;
+/* Wake the logger for the events an event thread logged this pass. */
+static void log_wake(void) {
+    if (log_wake_pending) {
+        log_wake_pending = 0;
+        sem_post(&game->log_items);
     }
+}
 
-    pthread_mutex_lock(&game->log_mutex);
-    strncpy(game->log_queue[game->log_tail], msg, LOG_MSG_LEN - 1);
-    game->log_queue[game->log_tail][LOG_MSG_LEN - 1] = '\0';
-    game->log_tail = (game->log_tail + 1) % LOG_QUEUE_SIZE;
-    pthread_mutex_unlock(&game->log_mutex);
-    sem_post(&game->log_items);
+/* Log a table-level event (join, leave, turn, round start, pause). */
+static void log_event(EventType type, int table, int seat, int round_no, const char *name) {
+    GameEvent ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = (uint8_t)type;
+    ev.table = (uint32_t)table;
+    ev.seat = (uint8_t)(seat < 0 ? 0 : seat);
+    ev.round_no = (uint32_t)round_no;
+    if (name) {
+        strncpy(ev.name, name, EVLOG_NAME_MAX - 1);
+    }
+    log_push(&ev);
+}
+
+/* When the logger forces game.log to disk. */
+typedef enum {
+    LOG_SYNC_NEVER,     /* leave it to the page cache (old behaviour) */
+    LOG_SYNC_BATCH,     /* fdatasync after every batch */
+    LOG_SYNC_INTERVAL   /* fdatasync at most every log_sync_interval_ms */
+} LogSyncPolicy;
+
+static LogSyncPolicy log_sync = LOG_SYNC_NEVER;
+static int log_sync_interval_ms = 1000;
+
+/* Logger counters (parent process only, written by the logger thread). */
+static unsigned long long log_lines = 0;
+static unsigned long long log_batches = 0;
+static unsigned long long log_syncs = 0;
+static unsigned long long log_bytes = 0;
+static long long log_busy_ns = 0;
+
+/* Take a ring's oldest published event, or return 0 if there is none yet. */
+static int dequeue_log(LogRing *ring, GameEvent *ev) {
+    unsigned long pos = ring->dequeue_pos;
+    LogSlot *slot = &ring->slots[pos & ring->mask];
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1) {
+        return 0;
+    }
+    *ev = slot->ev;
+    __atomic_store_n(&slot->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+    ring->dequeue_pos = pos + 1;
+    return 1;
+}
+
+/* Write a batch fully, retrying short writes. */
+static void write_batch(int fd, const unsigned char *batch, size_t used) {
+    size_t off = 0;
+    while (off < used) {
+        ssize_t w = write(fd, batch + off, used - off);
+        if (w < 0 && errno == EINTR) {
+            continue;
+        }
+        if (w <= 0) {
+            break;
+        }
+        off += (size_t)w;
+    }
 }
 
-/* Dedicated logger thread (parent process). */
+/*
+ * Dedicated logger thread (parent process). game.log stays open; each wakeup
+ * drains everything in the ring, packs the events into binary records
+ * (EventLog.c) and writes them in as few write()s as possible.
+ */
 static void *logger_thread(void *arg) {
     (void)arg;
-    while (server_running) {
-        if (sem_wait(&game->log_items) != 0) {
-            continue;
+    int fd = open(LOG_FILE, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror(LOG_FILE);
+        return NULL;
+    }
+    /* Append only to a binary log; anything else (an old text log) is moved aside. */
+    long long valid = evlog_scan(fd);
+    if (valid < 0) {
+        close(fd);
+        fprintf(stderr, "%s is not a binary event log; moved to %s\n", LOG_FILE, LOG_FILE_OLD);
+        if (rename(LOG_FILE, LOG_FILE_OLD) != 0) {
+            perror(LOG_FILE_OLD);
+        }
+        fd = open(LOG_FILE, O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            perror(LOG_FILE);
+            return NULL;
+        }
+    } else if (ftruncate(fd, (off_t)valid) != 0) {
+        perror(LOG_FILE);
+    }
+
+    static unsigned char batch[LOG_BATCH_BYTES];
+    int64_t base_ms = 0;
+    long long last_sync = now_ms();
+    int dirty = 0;
+
+    for (;;) {
+        /* Sleep until a producer posts; interval syncing needs a timeout. */
+        if (log_sync == LOG_SYNC_INTERVAL && dirty) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += log_sync_interval_ms / 1000;
+            deadline.tv_nsec += (long)(log_sync_interval_ms % 1000) * 1000000;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            sem_timedwait(&game->log_items, &deadline);
+        } else {
+            sem_wait(&game->log_items);
+        }
+        /* One drain covers every post made so far. */
+        while (sem_trywait(&game->log_items) == 0) {
+        }
+
+        long long start = now_ns();
+        size_t used = 0;
+        size_t lines = 0;
+        GameEvent ev;
+        /* The shared ring, then each shard's: a table's events all go through one ring, in order. */
+        LogRing **rings = __atomic_load_n(&shard_logs, __ATOMIC_ACQUIRE);
+        int ring_count = rings ? shard_log_count : 0;
+        for (int r = -1; r < ring_count; r++) {
+            LogRing *ring = r < 0 ? &game->log : rings[r];
+            while (dequeue_log(ring, &ev)) {
+                if (used + EVLOG_MAX_ENCODED > sizeof(batch)) {
+                    write_batch(fd, batch, used);
+                    log_batches++;
+                    log_bytes += used;
+                    used = 0;
+                }
+                used += evlog_encode(&ev, &base_ms, batch + used);
+                lines++;
+            }
+        }
+        if (used > 0) {
+            write_batch(fd, batch, used);
+            log_batches++;
+            log_bytes += used;
+        }
+        if (lines > 0) {
+            log_lines += lines;
+            dirty = 1;
         }
 
-        pthread_mutex_lock(&game->log_mutex);
-        char msg[LOG_MSG_LEN];
-        strncpy(msg, game->log_queue[game->log_head], LOG_MSG_LEN);
-        game->log_head = (game->log_head + 1) % LOG_QUEUE_SIZE;
-        pthread_mutex_unlock(&game->log_mutex);
-        sem_post(&game->log_spaces);
+        if (dirty && (log_sync == LOG_SYNC_BATCH ||
+                      (log_sync == LOG_SYNC_INTERVAL && now_ms() - last_sync >= log_sync_interval_ms))) {
+            fdatasync(fd);
+            log_syncs++;
+            last_sync = now_ms();
+            dirty = 0;
+        }
+        log_busy_ns += now_ns() - start;
 
-        FILE *fp = fopen("game.log", "a");
-        if (fp) {
-            fprintf(fp, "%s\n", msg);
-            fclose(fp);
+        /* On shutdown, leave only once the ring is drained. */
+        if (!server_running && lines == 0) {
+            break;
         }
     }
+
+    if (dirty && log_sync != LOG_SYNC_NEVER) {
+        fdatasync(fd);
+        log_syncs++;
+    }
+    close(fd);
     return NULL;
 }
 
-/* Load scores.txt into shared memory at startup. */
-static void load_scores_file(void) {
+/* Score journal state (parent process: score writer thread, startup and shutdown). */
+static int journal_fd = -1;
+static unsigned long journal_seq = 0;       /* last record appended */
+static unsigned long journal_records = 0;   /* records since the last compaction */
+static long long last_compact_ms = 0;
+static unsigned long long journal_appends = 0;
+static unsigned long long journal_wins = 0;
+static unsigned long long score_compactions = 0;
+
+/*
+ * Map the first size bytes of the scoreboard segment at scores_base. The
+ * range is reserved, so the board never moves and pointers into it stay good.
+ */
+static int scores_map(size_t size) {
+    if (mmap(scores_base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, scores_fd, 0) == MAP_FAILED) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Catch up with a board another process grew (caller holds score_mutex). */
+static void scores_sync_locked(void) {
+    int cap = scores.hdr->cap;
+    if (cap == scores_cap) {
+        return;
+    }
+    /* Within our own reservation this only fails if the process is out of mappings. */
+    if (scores_map(scoreboard_bytes(cap)) != 0) {
+        perror("scoreboard remap");
+        abort();
+    }
+    scoreboard_attach(&scores, scores_base, cap, 0);
+    scores_cap = cap;
+}
+
+/*
+ * Make room for one more player before a win is counted (caller holds
+ * score_mutex): a full board doubles, up to SCORE_MAX_CAP. Past that, wins
+ * by new players are dropped, counted in full_drops (see score_dropped).
+ */
+static void scores_make_room_locked(void) {
+    scores_sync_locked();
+    int cap = scores.hdr->cap;
+    if (scores.hdr->count < cap) {
+        return;
+    }
+    int new_cap = cap > SCORE_MAX_CAP / 2 ? SCORE_MAX_CAP : cap * 2;
+    if (new_cap > cap) {
+        size_t size = scoreboard_bytes(new_cap);
+        if (ftruncate(scores_fd, (off_t)size) == 0 && scores_map(size) == 0 &&
+            scoreboard_grow(&scores, new_cap) == 0) {
+            scores_cap = new_cap;
+            return;
+        }
+        perror("scoreboard grow");
+    }
+}
+
+/* After a put or win returned -1: say so once for the whole server. */
+static void score_dropped(void) {
+    if (scores.hdr->full_drops == 1) {
+        fprintf(stderr, "SCOREBOARD FULL at %d players: wins by new players are not counted\n",
+                scores.hdr->cap);
+    }
+}
+
+/*
+ * Load the scores.txt snapshot at startup. Returns the last journal sequence
+ * number it covers ("#journal N" header), 0 for an old headerless file.
+ */
+static unsigned long load_scores_file(void) {
     FILE *fp = fopen(SCORE_FILE, "r");
     if (!fp) {
-        return;
+        return 0;
     }
 
+    unsigned long seq = 0;
+    if (fscanf(fp, "#journal %lu", &seq) != 1) {
+        seq = 0;
+        rewind(fp);
+    }
     char name[MAX_NAME];
     int wins = 0;
     while (fscanf(fp, "%31s %d", name, &wins) == 2) {
-        if (game->score_count >= SCORE_MAX) {
+        scores_make_room_locked();
+        if (scoreboard_put(&scores, name, wins) < 0) {
+            score_dropped();
+        }
+    }
+    fclose(fp);
+    scoreboard_sort(&scores);
+    return seq;
+}
+
+/*
+ * Apply journal records newer than the snapshot. Each line is "seq name\n";
+ * a torn last line from a crash mid-append is ignored.
+ */
+static unsigned long replay_score_journal(unsigned long snapshot_seq) {
+    FILE *fp = fopen(SCORE_JOURNAL, "r");
+    if (!fp) {
+        return snapshot_seq;
+    }
+
+    unsigned long last = snapshot_seq;
+    char line[128];
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned long seq = 0;
+        char name[MAX_NAME];
+        if (!strchr(line, '\n') || sscanf(line, "%lu %31s", &seq, name) != 2) {
             break;
         }
-        strncpy(game->scores[game->score_count].name, name, MAX_NAME - 1);
-        game->scores[game->score_count].name[MAX_NAME - 1] = '\0';
-        game->scores[game->score_count].wins = wins;
-        game->score_count++;
+        if (seq > last) {
+            scores_make_room_locked();
+            if (scoreboard_win(&scores, name) < 0) {
+                score_dropped();
+            }
+            last = seq;
+        }
     }
     fclose(fp);
+    return last;
+}
+
+/* What a client is shown at the end of a round: the ranked top of the board. */
+typedef struct {
+    ScoreEntry top[SCOREBOARD_TOP];
+    int count;
+    int players;
+} ScoreView;
+
+static void score_view(ScoreView *v) {
+    pthread_mutex_lock(&game->score_mutex);
+    scores_sync_locked();
+    v->count = scoreboard_top(&scores, v->top, SCOREBOARD_TOP);
+    v->players = scores.hdr->count;
+    pthread_mutex_unlock(&game->score_mutex);
+}
+
+/* A player's rank (0 if they have never won) and win count. */
+static int score_rank_of(const char *name, int *wins) {
+    pthread_mutex_lock(&game->score_mutex);
+    scores_sync_locked();
+    int idx = scoreboard_find(&scores, name);
+    int rank = idx >= 0 ? scoreboard_rank(&scores, idx) : 0;
+    *wins = idx >= 0 ? scores.entries[idx].wins : 0;
+    pthread_mutex_unlock(&game->score_mutex);
+    return rank;
+}
+
+/* Append every queued win to the journal with one write() and one fdatasync(). */
+static void append_score_journal(void) {
+    char names[WIN_QUEUE][MAX_NAME];
+    pthread_mutex_lock(&game->score_mutex);
+    int n = game->win_count;
+    for (int i = 0; i < n; i++) {
+        memcpy(names[i], game->win_queue[(game->win_head + i) % WIN_QUEUE], MAX_NAME);
+    }
+    game->win_head = (game->win_head + n) % WIN_QUEUE;
+    game->win_count = 0;
+    pthread_mutex_unlock(&game->score_mutex);
+    if (n == 0 || journal_fd < 0) {
+        return;
+    }
+
+    unsigned char buf[WIN_QUEUE * (MAX_NAME + 24)];
+    size_t used = 0;
+    for (int i = 0; i < n; i++) {
+        used += (size_t)snprintf((char *)buf + used, sizeof(buf) - used, "%lu %s\n",
+                                 ++journal_seq, names[i]);
+    }
+    write_batch(journal_fd, buf, used);
+    fdatasync(journal_fd);
+    journal_appends++;
+    journal_wins += (unsigned long long)n;
+    journal_records += (unsigned long)n;
 }
 
-/* Persist scores from memory to disk. */
-static void save_scores_file(void) {
-    FILE *fp = fopen(SCORE_FILE, "w");
+/*
+ * Fold the journal into a new scores.txt: write a temp file, fsync it and
+ * rename it over the old one, then empty the journal. A crash at any point
+ * leaves either the old snapshot plus the journal or the new snapshot, and the
+ * "#journal N" header keeps records the snapshot already covers from being
+ * replayed twice.
+ */
+static void compact_scores(void) {
+    /*
+     * Only the win counts are copied under the lock: entries are append-only
+     * and a name never changes, so names are read from the board afterwards.
+     */
+    pthread_mutex_lock(&game->score_mutex);
+    scores_sync_locked();
+    int count = scores.hdr->count;
+    int *wins = malloc((size_t)(count > 0 ? count : 1) * sizeof(int));
+    if (!wins) {
+        pthread_mutex_unlock(&game->score_mutex);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        wins[i] = scores.entries[i].wins;
+    }
+    /* Queued wins are in the snapshot already; they get the next sequence numbers. */
+    unsigned long seq = journal_seq + (unsigned long)game->win_count;
+    game->win_overflow = 0;
+    pthread_mutex_unlock(&game->score_mutex);
+
+    FILE *fp = fopen(SCORE_FILE ".tmp", "w");
     if (!fp) {
+        free(wins);
+        return;
+    }
+    fprintf(fp, "#journal %lu\n", seq);
+    for (int i = 0; i < count; i++) {
+        fprintf(fp, "%s %d\n", scores.entries[i].name, wins[i]);
+    }
+    free(wins);
+    int ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(SCORE_FILE ".tmp", SCORE_FILE) != 0) {
+        unlink(SCORE_FILE ".tmp");
         return;
     }
-    for (int i = 0; i < game->score_count; i++) {
-        fprintf(fp, "%s %d\n", game->scores[i].name, game->scores[i].wins);
+    int dir_fd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
     }
-    fclose(fp);
+
+    if (journal_fd >= 0 && ftruncate(journal_fd, 0) == 0) {
+        journal_records = 0;
+    }
+    last_compact_ms = now_ms();
+    score_compactions++;
 }
 
-/* Update winner score (caller must hold state_mutex). */
-static void update_score_locked(const char *name) {
-    for (int i = 0; i < game->score_count; i++) {
-        if (strncmp(game->scores[i].name, name, MAX_NAME) == 0) {
-            game->scores[i].wins++;
-            return;
+/* Count a win for a player and queue it for the journal (caller holds score_mutex). */
+static void count_win_locked(const char *name) {
+    scores_make_room_locked();
+    if (scoreboard_win(&scores, name) < 0) {
+        score_dropped();
+    }
+    if (game->win_count < WIN_QUEUE) {
+        char *slot = game->win_queue[(game->win_head + game->win_count) % WIN_QUEUE];
+        strncpy(slot, name, MAX_NAME - 1);
+        slot[MAX_NAME - 1] = '\0';
+        game->win_count++;
+    } else {
+        game->win_overflow = 1;
+    }
+}
+
+/*
+ * Event threads collect their wins here instead of taking score_mutex on the
+ * turn path, and hand them over in one go (score_hand_over): before showing a
+ * scoreboard and at the end of every loop pass.
+ */
+static __thread int wins_deferred = 0;
+static __thread char local_wins[WIN_QUEUE][MAX_NAME];
+static __thread int local_win_count = 0;
+
+static void score_hand_over(void) {
+    if (local_win_count == 0) {
+        return;
+    }
+    pthread_mutex_lock(&game->score_mutex);
+    for (int i = 0; i < local_win_count; i++) {
+        count_win_locked(local_wins[i]);
+    }
+    pthread_mutex_unlock(&game->score_mutex);
+    local_win_count = 0;
+    sem_post(&game->score_dirty);
+}
+
+/* Count a win for a player and queue it for the journal. */
+static void record_win(const char *name) {
+    if (wins_deferred) {
+        if (local_win_count == WIN_QUEUE) {
+            score_hand_over();
         }
+        strncpy(local_wins[local_win_count], name, MAX_NAME - 1);
+        local_wins[local_win_count][MAX_NAME - 1] = '\0';
+        local_win_count++;
+        return;
     }
-    if (game->score_count < SCORE_MAX) {
-        strncpy(game->scores[game->score_count].name, name, MAX_NAME - 1);
-        game->scores[game->score_count].name[MAX_NAME - 1] = '\0';
-        game->scores[game->score_count].wins = 1;
-        game->score_count++;
+    pthread_mutex_lock(&game->score_mutex);
+    count_win_locked(name);
+    pthread_mutex_unlock(&game->score_mutex);
+    sem_post(&game->score_dirty);
+}
+
+/*
+ * Score writer thread (parent process). A win costs the game one queue push;
+ * this thread appends queued wins to scores.journal off every game lock and
+ * folds the journal into scores.txt every SCORE_COMPACT_RECORDS records or
+ * SCORE_COMPACT_MS, whichever comes first.
+ */
+static void *score_writer_thread(void *arg) {
+    (void)arg;
+    while (server_running) {
+        if (journal_records > 0) {
+            long long wait_ms = last_compact_ms + SCORE_COMPACT_MS - now_ms();
+            if (wait_ms < 0) {
+                wait_ms = 0;
+            }
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += (time_t)(wait_ms / 1000);
+            deadline.tv_nsec += (long)(wait_ms % 1000) * 1000000;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            sem_timedwait(&game->score_dirty, &deadline);
+        } else {
+            sem_wait(&game->score_dirty);
+        }
+        while (sem_trywait(&game->score_dirty) == 0) {
+        }
+
+        append_score_journal();
+        if (__atomic_load_n(&game->win_overflow, __ATOMIC_RELAXED) ||
+            journal_records >= SCORE_COMPACT_RECORDS ||
+            (journal_records > 0 && now_ms() - last_compact_ms >= SCORE_COMPACT_MS)) {
+            compact_scores();
+        }
     }
+    return NULL;
 }
 
-/* Apply snakes or ladders if the player landed on one. */
-static int apply_snakes_ladders(int pos) {
-    for (int i = 0; i < 4; i++) {
-        if (snakes[i][0] == pos) {
-            return snakes[i][1];
+/*
+ * Append the table's buffered turns to games.rec as one record (caller holds
+ * the table lock). The last record of a round (outcome != REC_MORE) also
+ * carries the names of the seats that started it.
+ */
+static void rec_flush_locked(GameTable *t, RecOutcome outcome, int winner) {
+    if (rec_fd < 0) {
+        return;
+    }
+    RecHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = REC_MAGIC;
+    h.outcome = (uint8_t)outcome;
+    h.winner = (uint8_t)(winner < 0 ? 0 : winner);
+    h.table = (uint32_t)(t - game->tables);
+    h.round_no = (uint32_t)t->round_no;
+    h.part = (uint32_t)t->rec_part;
+    h.turns = (uint32_t)t->rec_turns;
+    h.seed = dice_seed_value;
+    h.board_id = board_fingerprint;
+    memcpy(h.dice, t->rec_dice.s, sizeof(h.dice));
+
+    unsigned char names[MAX_PLAYERS * (2 + MAX_NAME)];
+    size_t names_len = 0;
+    if (outcome != REC_MORE) {
+        for (int s = 0; s < MAX_PLAYERS; s++) {
+            if (!(t->rec_seats & (1 << s))) {
+                continue;
+            }
+            size_t len = strnlen(t->player_name[s], MAX_NAME - 1);
+            names[names_len] = (unsigned char)s;
+            names[names_len + 1] = (unsigned char)len;
+            memcpy(names + names_len + 2, t->player_name[s], len);
+            names_len += 2 + len;
+            h.seats++;
         }
     }
-    for (int i = 0; i < 4; i++) {
-        if (ladders[i][0] == pos) {
-            return ladders[i][1];
+    h.bytes = (uint32_t)(sizeof(h) + names_len + (size_t)t->rec_turns);
+
+    /* One writev on an O_APPEND descriptor: records from different processes never interleave. */
+    struct iovec iov[3] = {
+        {&h, sizeof(h)},
+        {names, names_len},
+        {t->rec_buf, (size_t)t->rec_turns},
+    };
+    if (writev(rec_fd, iov, 3) == (ssize_t)h.bytes) {
+        __atomic_fetch_add(&game->rec_records, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&game->rec_bytes, h.bytes, __ATOMIC_RELAXED);
+        if (outcome != REC_MORE) {
+            __atomic_fetch_add(&game->rec_rounds, 1, __ATOMIC_RELAXED);
         }
+    } else {
+        __atomic_fetch_add(&game->rec_errors, 1, __ATOMIC_RELAXED);
+    }
+    t->rec_part++;
+    t->rec_turns = 0;
+    t->rec_dice = t->dice;
+}
+
+/*
+ * Buffer one turn byte for the recording (caller holds the table lock). A full
+ * chunk goes out as a REC_MORE part, but only after a winning roll had the
+ * chance to end the round in the same record.
+ */
+static void rec_turn_locked(GameTable *t, uint8_t turn, int won, int seat) {
+    t->rec_buf[t->rec_turns++] = turn;
+    if (won) {
+        rec_flush_locked(t, REC_WON, seat);
+    } else if (t->rec_turns == REC_CHUNK) {
+        rec_flush_locked(t, REC_MORE, -1);
+    }
+}
+
+/* Apply a dice roll for a seat, including the win check (caller holds the table lock). */
+static void apply_roll_locked(GameTable *t, int id, int dice, TurnResult *r) {
+    /* Exact roll is needed to land on the last square; board_turn keeps us put otherwise. */
+    board_turn(&board, &t->position[id], dice, r);
+    t->turn_count++;
+    metrics_count(&my_metrics()->turns);
+
+    if (r->won && t->game_over) {
+        r->won = 0;
+    } else if (r->won) {
+        t->game_over = 1;
+        t->winner_id = id;
+        record_win(t->player_name[id]);
+        metrics_count(&my_metrics()->wins);
     }
-    return pos;
+    rec_turn_locked(t, REC_ROLL(id, dice), r->won, id);
+}
+
+/* Log one roll as a single event; snl-logdump expands it into text lines. */
+static void log_turn(int table, const GameTable *t, int id, const TurnResult *r) {
+    GameEvent ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = EV_ROLL;
+    ev.table = (uint32_t)table;
+    ev.seat = (uint8_t)id;
+    ev.round_no = (uint32_t)t->round_no;
+    ev.dice = (uint8_t)r->dice;
+    ev.from = r->before;
+    ev.to = r->after;
+    ev.flags = (uint8_t)((r->moved ? 0 : EVF_NO_MOVE) | (r->won ? EVF_WON : 0));
+    log_push(&ev);
 }
 
-/* Reset positions and round info (caller holds state_mutex). */
-static void reset_game_locked(void) {
+/* Reset positions and round info (caller holds the table lock). */
+static void reset_game_locked(GameTable *t) {
     for (int i = 0; i < MAX_PLAYERS; i++) {
-        game->position[i] = 0;
+        t->position[i] = 0;
     }
-    game->current_turn = 0;
-    game->game_over = 0;
-    game->winner_id = -1;
-    game->game_over_notice = 0;
-    game->turn_count = 0;
-    game->board_show_every = 3;
-    game->game_started = 1;
-    game->round_no++;
+    t->current_turn = 0;
+    t->game_over = 0;
+    t->winner_id = -1;
+    t->game_over_notice = 0;
+    t->turn_count = 0;
+    t->board_show_every = 3;
+    __atomic_store_n(&t->game_started, 1, __ATOMIC_RELAXED);
+    t->round_no++;
+    t->round_started_ns = now_ns();
+
+    /* Start recording the round from the table's current dice state. */
+    t->rec_seats = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        t->rec_seats |= t->connected[i] ? 1 << i : 0;
+    }
+    t->rec_part = 0;
+    t->rec_turns = 0;
+    t->rec_dice = t->dice;
+}
+
+/* First YOUR_TURN of a round went out: record how long the start took. */
+static void note_round_start(GameTable *t) {
+    if (t->turn_count != 0 || t->round_started_ns == 0) {
+        return;
+    }
+    long long delta = now_ns() - t->round_started_ns;
+    t->round_started_ns = 0;
+    hist_record(&my_metrics()->round_start, delta);
 }
 
 /* Build "name:pos" list for the scoreboard line. */
-static void build_positions_locked(char *out, size_t len) {
+static void build_positions_locked(const GameTable *t, char *out, size_t len) {
     size_t used = 0;
     out[0] = '\0';
 
     for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (!game->connected[i]) {
+        if (!t->connected[i]) {
             continue;
         }
         int written = 0;
-        if (game->player_name[i][0]) {
+        if (t->player_name[i][0]) {
             written = snprintf(out + used, len - used, "%s:%d ",
-                               game->player_name[i], game->position[i]);
+                               t->player_name[i], t->position[i]);
         } else {
             written = snprintf(out + used, len - used, "Player%d:%d ",
-                               i + 1, game->position[i]);
+                               i + 1, t->position[i]);
         }
         if (written < 0 || (size_t)written >= len - used) {
             break;
@@ -259,33 +997,171 @@ static void build_positions_locked(char *out, size_t len) {
     }
 }
 
-/* Build a simple 10x10 board (serpentine numbering). */
-static void build_board_locked(char *out, size_t len) {
+/*
+ * Board updates for clients that draw the board themselves. PROTO_DELTA
+ * clients get them as lines; positions are absolute, so a repeated update
+ * does no harm:
+ *   @B size cols          board geometry, once at join
+ *   @S seat:pos:name ...  every seated player (1-based seats), on join,
+ *                         round start, roster change or "@resync"
+ *   @D seat:pos ...       the positions that changed
+ *   @R                    draw the board now
+ * PROTO_BINARY clients get the same as WIRE_PLAYERS and WIRE_POSITIONS (with
+ * 0-based seats); the geometry is in WIRE_WELCOME and "draw now" is a flag of
+ * WIRE_TURN_START.
+ */
+static void out_board_geometry(OutBuf *out) {
+    outbuf_printf(out, "@B %d %d\n", board_size(&board), board.cols);
+}
+
+static const char *seat_name_locked(const GameTable *t, int seat, char *buf, size_t len) {
+    if (t->player_name[seat][0]) {
+        return t->player_name[seat];
+    }
+    snprintf(buf, len, "Player%d", seat + 1);
+    return buf;
+}
+
+static void out_snapshot_locked(OutBuf *out, ClientProto proto, const GameTable *t) {
+    char fallback[16];
+    if (proto == PROTO_BINARY) {
+        size_t at = wire_begin(out, WIRE_PLAYERS);
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            if (t->connected[i]) {
+                wire_u8(out, (unsigned)i);
+                wire_u32(out, (uint32_t)t->position[i]);
+                wire_name(out, seat_name_locked(t, i, fallback, sizeof(fallback)));
+            }
+        }
+        wire_end(out, at);
+        return;
+    }
+    outbuf_puts(out, "@S");
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (t->connected[i]) {
+            outbuf_printf(out, " %d:%d:%s", i + 1, t->position[i],
+                          seat_name_locked(t, i, fallback, sizeof(fallback)));
+        }
+    }
+    outbuf_puts(out, "\n");
+}
+
+/* Positions of the seats in `seats` (a bit per seat), as @D or WIRE_POSITIONS. */
+static void out_positions_locked(OutBuf *out, ClientProto proto, const GameTable *t, unsigned seats) {
+    if (proto == PROTO_BINARY) {
+        size_t at = wire_begin(out, WIRE_POSITIONS);
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            if (seats & (1u << i)) {
+                wire_u8(out, (unsigned)i);
+                wire_u32(out, (uint32_t)t->position[i]);
+            }
+        }
+        wire_end(out, at);
+        return;
+    }
+    outbuf_puts(out, "@D");
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (seats & (1u << i)) {
+            outbuf_printf(out, " %d:%d", i + 1, t->position[i]);
+        }
+    }
+    outbuf_puts(out, "\n");
+}
+
+/* What one client was last told about its table (fork mode). */
+typedef struct {
+    int pos[MAX_PLAYERS];    /* -1 = no player */
+    unsigned roster_gen;
+} SentView;
+
+/* Forget everything, so the next update is a snapshot. */
+static void sent_view_reset(SentView *v) {
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        v->pos[i] = -1;
+    }
+    v->roster_gen = ~0u;
+}
+
+/*
+ * Bring a client from what it was last sent to the table as it is: a
+ * snapshot if players came, went or were renamed, else the changed
+ * positions, else nothing.
+ */
+static void out_changes_locked(OutBuf *out, ClientProto proto, const GameTable *t, SentView *sent) {
+    int roster_changed = sent->roster_gen != t->roster_gen;
+    unsigned moved = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (t->connected[i] != (sent->pos[i] >= 0)) {
+            roster_changed = 1;
+        } else if (t->connected[i] && t->position[i] != sent->pos[i]) {
+            moved |= 1u << i;
+        }
+    }
+    if (roster_changed) {
+        out_snapshot_locked(out, proto, t);
+    } else if (moved) {
+        out_positions_locked(out, proto, t, moved);
+    }
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        sent->pos[i] = t->connected[i] ? t->position[i] : -1;
+    }
+    sent->roster_gen = t->roster_gen;
+}
+
+/*
+ * Draw the board as a serpentine grid, board.cols squares per row, top row
+ * first. Boards taller than BOARD_SHOW_ROWS only show the finishing row and
+ * the rows that hold a player, with "..." where rows are skipped.
+ */
+static void build_board_locked(const GameTable *t, char *out, size_t len) {
+    int size = board_size(&board);
+    int cols = board.cols;
+    int rows = (size + cols - 1) / cols;
+    int width = snprintf(NULL, 0, "%d", size);
+    if (width < 4) {
+        width = 4;
+    }
     size_t used = 0;
+    int skipped = 0;
     out[0] = '\0';
 
-    /* We render from row 10 down to row 1 to match the usual board view. */
-    for (int row = 9; row >= 0; row--) {
+    for (int row = rows - 1; row >= 0; row--) {
+        int players_in_row = 0;
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            if (t->connected[i] && t->position[i] > 0 && (t->position[i] - 1) / cols == row) {
+                players_in_row++;
+            }
+        }
+        if (rows > BOARD_SHOW_ROWS && row != rows - 1 && players_in_row == 0) {
+            skipped = 1;
+            continue;
+        }
+
         char line[256];
         size_t off = 0;
-        int start = row * 10 + 1;
-
-        for (int col = 0; col < 10; col++) {
+        if (skipped) {
+            off = (size_t)snprintf(line, sizeof(line), "  ...\n");
+            skipped = 0;
+        }
+        int start = row * cols + 1;
+        for (int col = 0; col < cols; col++) {
             /* Serpentine numbering: every other row is reversed. */
-            int num = (row % 2 == 0) ? (start + col) : (start + (9 - col));
+            int num = (row % 2 == 0) ? (start + col) : (start + (cols - 1 - col));
             int players_here = 0;
             int last_id = -1;
 
             for (int i = 0; i < MAX_PLAYERS; i++) {
-                if (game->connected[i] && game->position[i] == num) {
+                if (t->connected[i] && t->position[i] == num) {
                     players_here++;
                     last_id = i;
                 }
             }
 
-            /* Cell shows number, single player (P#), or multi (M#). */
+            /* Cell shows number, single player (P#), or multi (M#); blank past the end. */
             char cell[16];
-            if (players_here == 0) {
+            if (num > size) {
+                cell[0] = '\0';
+            } else if (players_here == 0) {
                 snprintf(cell, sizeof(cell), "%d", num);
             } else if (players_here == 1) {
                 snprintf(cell, sizeof(cell), "P%d", last_id + 1);
@@ -293,28 +1169,15 @@ static void build_board_locked(char *out, size_t len) {
                 snprintf(cell, sizeof(cell), "M%d", players_here);
             }
 
-            if (off >= sizeof(line)) {
-                break;
-            }
-            int w = snprintf(line + off, sizeof(line) - off, "[%4s]", cell);
+            int w = snprintf(line + off, sizeof(line) - off, "[%*s]", width, cell);
             if (w < 0 || (size_t)w >= sizeof(line) - off) {
-                off = sizeof(line) - 1;
-                line[off] = '\0';
+                off = sizeof(line) - 2;
                 break;
             }
             off += (size_t)w;
         }
+        line[off++] = '\n';
 
-        /* Add newline at the end of each row. */
-        if (off < sizeof(line)) {
-            int w = snprintf(line + off, sizeof(line) - off, "\n");
-            if (w < 0 || (size_t)w >= sizeof(line) - off) {
-                off = sizeof(line) - 1;
-                line[off] = '\0';
-            } else {
-                off += (size_t)w;
-            }
-        }
         if (used + off >= len) {
             break;
         }
@@ -325,354 +1188,2572 @@ static void build_board_locked(char *out, size_t len) {
 }
 
 /* Find next connected player after index (round robin). */
-static int find_next_active_locked(int after) {
+static int find_next_active_locked(const GameTable *t, int after) {
     for (int i = 1; i <= MAX_PLAYERS; i++) {
         int idx = (after + i) % MAX_PLAYERS;
-        if (game->connected[idx]) {
+        if (t->connected[idx]) {
             return idx;
         }
     }
     return -1;
 }
 
-/* Scheduler thread: decides whose turn it is and signals them. */
+/*
+ * Queue a table for the scheduler thread and wake it (caller holds the table
+ * lock; sched_mutex is taken here). In epoll mode the event loop schedules
+ * inline, so this is a no-op.
+ */
+static void wake_table_locked(GameTable *t) {
+    if (event_mode) {
+        return;
+    }
+    pthread_mutex_lock(&game->sched_mutex);
+    if (!t->queued) {
+        int idx = (int)(t - game->tables);
+        t->queued = 1;
+        t->ready_next = -1;
+        if (game->ready_tail < 0) {
+            game->ready_head = idx;
+        } else {
+            game->tables[game->ready_tail].ready_next = idx;
+        }
+        game->ready_tail = idx;
+    }
+    pthread_cond_signal(&game->sched_cond);
+    pthread_mutex_unlock(&game->sched_mutex);
+}
+
+/* Release a seat when its client goes away (caller holds the table lock). */
+static void leave_table_locked(GameTable *t, int id) {
+    if (!t->connected[id]) {
+        return;
+    }
+    t->connected[id] = 0;
+    __atomic_fetch_sub(&t->active_players, 1, __ATOMIC_RELAXED);
+    metrics_count(&my_metrics()->disconnects);
+    t->roster_gen++;
+    t->seat_gen[id]++;
+    if (t->game_started && !t->game_over) {
+        rec_turn_locked(t, REC_LEAVE(id), 0, id);
+    }
+    if (t->current_turn == id) {
+        t->turn_finished = 1;
+    }
+    wake_table_locked(t);
+}
+
+/* Take a free seat if the table is gathering players; -1 if not (caller holds the table lock). */
+static int claim_seat_locked(GameTable *t) {
+    if (t->game_started || t->active_players >= game->target_players) {
+        return -1;
+    }
+    for (int s = 0; s < MAX_PLAYERS; s++) {
+        if (!t->connected[s]) {
+            t->connected[s] = 1;
+            __atomic_fetch_add(&t->active_players, 1, __ATOMIC_RELAXED);
+            t->player_name[s][0] = '\0';
+            t->strikes[s] = 0;
+            return s;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Matchmaking among tables first..last-1 (a shard's own tables): fill a
+ * table that is still gathering players first, then open an empty one.
+ * Returns 0 with the seat already claimed, or -1 if every table is busy. Tables are peeked at without their lock and only locked to
+ * claim, so a join never serializes against turns on other tables.
+ */
+static int find_open_seat(int first, int last, int *table_out, int *seat_out) {
+    int empty = -1;
+    for (int i = first; i < last; i++) {
+        GameTable *t = &game->tables[i];
+        int active = __atomic_load_n(&t->active_players, __ATOMIC_RELAXED);
+        if (__atomic_load_n(&t->game_started, __ATOMIC_RELAXED) ||
+            active >= game->target_players) {
+            continue;
+        }
+        if (active == 0) {
+            if (empty < 0) {
+                empty = i;
+            }
+            continue;
+        }
+        pthread_mutex_lock(&t->lock);
+        int seat = claim_seat_locked(t);
+        pthread_mutex_unlock(&t->lock);
+        if (seat >= 0) {
+            *table_out = i;
+            *seat_out = seat;
+            return 0;
+        }
+    }
+    if (empty < 0) {
+        return -1;
+    }
+
+    GameTable *t = &game->tables[empty];
+    pthread_mutex_lock(&t->lock);
+    int seat = claim_seat_locked(t);
+    pthread_mutex_unlock(&t->lock);
+    if (seat < 0) {
+        return -1;
+    }
+    *table_out = empty;
+    *seat_out = seat;
+    return 0;
+}
+
+/* Scheduler bookkeeping for one table (parent process only). */
+typedef struct {
+    int last_turn;
+    int last_round;
+    int turn_pending;
+    long long restart_at;
+    WheelTimer turn_timer;      /* the pending turn's deadline (id = table) */
+} TableSched;
+
+static TableSched *sched = NULL;
+
+/*
+ * Timers belong to the thread that schedules their tables: the scheduler
+ * thread, or each event loop (one per shard), so they are thread-local.
+ */
+
+/* Turn deadlines of the thread's tables (set up by wheel_init when the thread starts). */
+static __thread TimerWheel turn_wheel;
+
+/* Pending round restarts, as a min-heap on the deadline. */
+typedef struct {
+    long long due;
+    int table;
+    int round_no;
+} RoundTimer;
+
+static __thread RoundTimer *timers = NULL;
+static __thread int timer_count = 0;
+static __thread int timer_cap = 0;
+
+static void timer_push(long long due, int table, int round_no) {
+    if (timer_count == timer_cap) {
+        int cap = timer_cap ? timer_cap * 2 : 64;
+        RoundTimer *grown = realloc(timers, (size_t)cap * sizeof(RoundTimer));
+        if (!grown) {
+            return;
+        }
+        timers = grown;
+        timer_cap = cap;
+    }
+    int i = timer_count++;
+    while (i > 0 && timers[(i - 1) / 2].due > due) {
+        timers[i] = timers[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    timers[i].due = due;
+    timers[i].table = table;
+    timers[i].round_no = round_no;
+}
+
+/* Earliest deadline, or -1 when nothing is pending. */
+static long long timer_next_due(void) {
+    return timer_count > 0 ? timers[0].due : -1;
+}
+
+static RoundTimer timer_pop(void) {
+    RoundTimer top = timers[0];
+    RoundTimer last = timers[--timer_count];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= timer_count) {
+            break;
+        }
+        if (child + 1 < timer_count && timers[child + 1].due < timers[child].due) {
+            child++;
+        }
+        if (timers[child].due >= last.due) {
+            break;
+        }
+        timers[i] = timers[child];
+        i = child;
+    }
+    if (timer_count > 0) {
+        timers[i] = last;
+    }
+    return top;
+}
+
+/* Event-loop hooks (epoll mode hands turns out directly instead of via semaphores). */
+static void ev_begin_turn(int table, int seat);
+static void ev_game_over(int table);
+static void ev_round_start(int table);
+static void ev_turn_timeout(int table, int seat, int drop);
+
+/* Hand the turn to a seat (caller holds the table lock). */
+static void signal_turn_locked(int table, int seat) {
+    if (event_mode) {
+        ev_begin_turn(table, seat);
+    } else {
+        game->tables[table].turn_signaled_ns = now_ns();
+        sem_post(&game->tables[table].turn_sem[seat]);
+    }
+}
+
+/*
+ * Fork mode: keep a move for the other seats and wake them, so each child
+ * shows it to its player (out_moves_locked) instead of only its own rolls
+ * (caller holds the table lock).
+ */
+static void note_move_locked(GameTable *t, int seat, const TurnResult *r) {
+    MoveRecord *m = &t->moves[t->move_seq % MOVE_HISTORY];
+    m->seat = seat;
+    strncpy(m->name, t->player_name[seat], MAX_NAME - 1);
+    m->name[MAX_NAME - 1] = '\0';
+    m->result = *r;
+    t->move_seq++;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (i != seat && t->connected[i]) {
+            sem_post(&t->turn_sem[i]);
+        }
+    }
+}
+
+/* Wake every seat so they see the game-over notice (caller holds the table lock). */
+static void signal_game_over_locked(int table) {
+    GameTable *t = &game->tables[table];
+    if (event_mode) {
+        ev_game_over(table);
+        return;
+    }
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (t->connected[i]) {
+            sem_post(&t->turn_sem[i]);
+        }
+    }
+}
+
+/* Advance one table as far as it can go right now (caller holds the table lock). */
+static void schedule_table_locked(int table) {
+    GameTable *t = &game->tables[table];
+    TableSched *ts = &sched[table];
+
+    /* Collect a finished turn first. */
+    if (ts->turn_pending) {
+        if (!t->turn_finished) {
+            return;
+        }
+        ts->turn_pending = 0;
+        ts->last_turn = t->current_turn;
+        wheel_cancel(&turn_wheel, &ts->turn_timer);
+        if (t->turn_done_ns) {
+            hist_record(&my_metrics()->phase[PHASE_SCHED], now_ns() - t->turn_done_ns);
+            t->turn_done_ns = 0;
+        }
+    }
+
+    /* If game is over, wake everyone once so they can see the notice. */
+    if (t->game_over) {
+        if (t->game_over_notice != t->round_no) {
+            t->game_over_notice = t->round_no;
+            ts->restart_at = now_ms() + round_pause_ms;
+            signal_game_over_locked(table);
+            if (round_pause_ms > 0) {
+                timer_push(ts->restart_at, table, t->round_no);
+            }
+        }
+        /* Not enough players left for another round: reopen the table. */
+        if (t->active_players < MIN_PLAYERS) {
+            __atomic_store_n(&t->game_started, 0, __ATOMIC_RELAXED);
+            return;
+        }
+        /* Auto-restart a new round once the pause has passed. */
+        if (now_ms() < ts->restart_at) {
+            return;
+        }
+        reset_game_locked(t);
+        log_event(EV_ROUND_START, table, -1, t->round_no, NULL);
+        if (event_mode) {
+            ev_round_start(table);
+        }
+    }
+
+    if (!t->game_started) {
+        return;
+    }
+
+    /* Too many players left mid-round: reopen the table for matchmaking. */
+    if (t->active_players < MIN_PLAYERS) {
+        __atomic_store_n(&t->game_started, 0, __ATOMIC_RELAXED);
+        rec_flush_locked(t, REC_ABORTED, -1);
+        log_event(EV_TABLE_PAUSED, table, -1, t->round_no, NULL);
+        return;
+    }
+
+    /* New round: reset our turn pointer. */
+    if (t->round_no != ts->last_round) {
+        ts->last_round = t->round_no;
+        ts->last_turn = -1;
+    }
+
+    /* Pick next player in order. */
+    int next = find_next_active_locked(t, ts->last_turn);
+    if (next < 0) {
+        return;
+    }
+
+    t->current_turn = next;
+    t->turn_finished = 0;
+    t->turn_seq++;
+    t->turn_deadline_ms = 0;
+    if (turn_timeout_ms > 0) {
+        t->turn_deadline_ms = now_ms() + turn_timeout_ms;
+        wheel_arm(&turn_wheel, &ts->turn_timer, t->turn_deadline_ms);
+    }
+    ts->turn_pending = 1;
+    log_event(EV_TURN, table, next, t->round_no, NULL);
+
+    /* Let that player take the turn. */
+    signal_turn_locked(table, next);
+}
+
+/* Restart every table whose round pause has run out (takes each table lock). */
+static void run_due_timers(void) {
+    long long now = now_ms();
+    while (timer_count > 0 && timers[0].due <= now) {
+        RoundTimer rt = timer_pop();
+        GameTable *t = &game->tables[rt.table];
+        pthread_mutex_lock(&t->lock);
+        /* Skip timers for rounds that already moved on. */
+        if (t->game_over && t->round_no == rt.round_no) {
+            schedule_table_locked(rt.table);
+        }
+        pthread_mutex_unlock(&t->lock);
+    }
+}
+
+/*
+ * The current turn ran past its deadline: roll for the player so the table
+ * moves on, and drop them once they have done that turn_strikes times in a
+ * row (caller holds the table lock). In fork mode the player's process picks
+ * the result up from auto_result and tells its client.
+ */
+static void turn_timeout_locked(int table) {
+    GameTable *t = &game->tables[table];
+    if (!sched[table].turn_pending || t->turn_finished || !t->game_started || t->game_over) {
+        return;
+    }
+    int id = t->current_turn;
+    int drop = turn_strikes > 0 && ++t->strikes[id] >= turn_strikes;
+    metrics_count(&my_metrics()->timeouts);
+    if (drop) {
+        metrics_count(&my_metrics()->idle_drops);
+    }
+    if (event_mode) {
+        ev_turn_timeout(table, id, drop);
+        return;
+    }
+    apply_roll_locked(t, id, dice_roll(&t->dice), &t->auto_result);
+    log_turn(table, t, id, &t->auto_result);
+    note_move_locked(t, id, &t->auto_result);
+    t->auto_seq = t->turn_seq;
+    t->turn_finished = 1;
+    t->turn_done_ns = now_ns();
+    if (drop) {
+        leave_table_locked(t, id);
+        log_event(EV_LEAVE, table, id, t->round_no, NULL);
+    }
+    schedule_table_locked(table);
+}
+
+/* Auto-roll every turn whose deadline has passed (takes each table lock). */
+static void run_turn_timeouts(void) {
+    WheelTimer *wt;
+    while ((wt = wheel_expire(&turn_wheel, now_ms())) != NULL) {
+        GameTable *t = &game->tables[wt->id];
+        pthread_mutex_lock(&t->lock);
+        turn_timeout_locked(wt->id);
+        pthread_mutex_unlock(&t->lock);
+    }
+}
+
+/* Earliest round restart or turn deadline, or -1 if nothing is pending. */
+static long long next_timer_due(void) {
+    long long due = timer_next_due();
+    long long turn_due = wheel_next_due(&turn_wheel);
+    if (due < 0 || (turn_due >= 0 && turn_due < due)) {
+        due = turn_due;
+    }
+    return due;
+}
+
+/*
+ * Scheduler thread: sleeps on sched_cond until a table is queued by a join,
+ * a finished turn or a disconnect, or until the next round pause or turn
+ * deadline runs out.
+ * sched_mutex only covers the ready list; each table is advanced under its
+ * own lock, so turns on other tables keep going meanwhile.
+ */
 static void *scheduler_thread(void *arg) {
     (void)arg;
-    int last_turn = -1;
-    int last_round = 0;
+    if (wheel_init(&turn_wheel, TURN_WHEEL_SLOTS, TURN_WHEEL_TICK_MS, now_ms()) != 0) {
+        perror("turn wheel");
+        return NULL;
+    }
+    pthread_mutex_lock(&game->sched_mutex);
+    while (server_running) {
+        long long due = next_timer_due();
+        if (game->ready_head < 0 && (due < 0 || due > now_ms())) {
+            if (due < 0) {
+                pthread_cond_wait(&game->sched_cond, &game->sched_mutex);
+            } else {
+                struct timespec deadline;
+                deadline.tv_sec = (time_t)(due / 1000);
+                deadline.tv_nsec = (long)(due % 1000) * 1000000;
+                pthread_cond_timedwait(&game->sched_cond, &game->sched_mutex, &deadline);
+            }
+            continue;
+        }
+
+        pthread_mutex_unlock(&game->sched_mutex);
+        run_due_timers();
+        run_turn_timeouts();
+        pthread_mutex_lock(&game->sched_mutex);
+        while (game->ready_head >= 0) {
+            int i = game->ready_head;
+            GameTable *t = &game->tables[i];
+            game->ready_head = t->ready_next;
+            if (game->ready_head < 0) {
+                game->ready_tail = -1;
+            }
+            t->queued = 0;
+            pthread_mutex_unlock(&game->sched_mutex);
+
+            pthread_mutex_lock(&t->lock);
+            schedule_table_locked(i);
+            pthread_mutex_unlock(&t->lock);
+
+            pthread_mutex_lock(&game->sched_mutex);
+        }
+    }
+    pthread_mutex_unlock(&game->sched_mutex);
+    wheel_free(&turn_wheel);
+    return NULL;
+}
+
+/* Send a plain text line (already includes newline). */
+static void send_line(int sock, const char *msg) {
+    send(sock, msg, strlen(msg), MSG_NOSIGNAL);
+}
+
+/* Queue the ranked top of the scoreboard, plus the player's own rank. */
+static void out_scoreboard(OutBuf *out, ClientProto proto, const ScoreView *v, const char *my_name) {
+    int wins = 0;
+    int my_rank = my_name[0] ? score_rank_of(my_name, &wins) : 0;
+    if (proto == PROTO_BINARY) {
+        size_t at = wire_begin(out, WIRE_SCOREBOARD);
+        wire_u32(out, (uint32_t)v->players);
+        wire_u32(out, (uint32_t)my_rank);
+        wire_u32(out, (uint32_t)wins);
+        for (int i = 0; i < v->count; i++) {
+            wire_u32(out, (uint32_t)v->top[i].wins);
+            wire_name(out, v->top[i].name);
+        }
+        wire_end(out, at);
+        return;
+    }
+    if (v->count <= 0) {
+        outbuf_puts(out, "Scoreboard:\n  (no scores yet)\n");
+        return;
+    }
+    outbuf_printf(out, "Scoreboard (top %d of %d):\n", v->count, v->players);
+    /* Ties share a rank. */
+    int rank = 1;
+    for (int i = 0; i < v->count; i++) {
+        if (i > 0 && v->top[i].wins != v->top[i - 1].wins) {
+            rank = i + 1;
+        }
+        outbuf_printf(out, "  %d) %s - %d wins\n", rank, v->top[i].name, v->top[i].wins);
+    }
+    if (my_rank > 0) {
+        outbuf_printf(out, "  You: #%d of %d (%d wins)\n", my_rank, v->players, wins);
+    }
+}
+
+/* Queue the end-of-round banner for the client (winner < 0: nobody won). */
+static void out_game_over(OutBuf *out, ClientProto proto, int winner, const char *winner_name,
+                          const ScoreView *v, const char *my_name) {
+    if (proto == PROTO_BINARY) {
+        size_t at = wire_begin(out, WIRE_GAME_OVER);
+        wire_u8(out, winner_name[0] && winner >= 0 ? (unsigned)winner : WIRE_NO_SEAT);
+        wire_name(out, winner_name);
+        wire_end(out, at);
+        out_scoreboard(out, proto, v, my_name);
+        return;
+    }
+    outbuf_puts(out, "\n==============================\n");
+    if (winner_name[0]) {
+        outbuf_printf(out, "WINNER: %s\n", winner_name);
+    } else {
+        outbuf_puts(out, "GAME OVER\n");
+    }
+    outbuf_puts(out, "==============================\n");
+    out_scoreboard(out, proto, v, my_name);
+}
+
+/* Queue the messages describing one roll (positions: text clients only). */
+static void out_turn_result(OutBuf *out, ClientProto proto, int seat, const char *name,
+                            const TurnResult *r, const char *positions) {
+    if (proto == PROTO_BINARY) {
+        wire_roll_result(out, seat, r);
+        return;
+    }
+    outbuf_printf(out, "Player %s rolled %d -> position %d\n", name, r->dice, r->after);
+
+    /* Extra messages for special cases. */
+    if (!r->moved) {
+        outbuf_printf(out, "Exact roll needed to reach %d. %s stays in place.\n", board_size(&board), name);
+    }
+    if (r->jump_from != 0) {
+        outbuf_printf(out, "%s %d -> %d\n", r->jump_to < r->jump_from ? "Snake!" : "Ladder!",
+                      r->jump_from, r->jump_to);
+    }
+    if (positions[0]) {
+        outbuf_printf(out, "Positions: %s\n", positions);
+    }
+    if (r->won) {
+        outbuf_printf(out, "Player %s WON the game\n", name);
+    }
+}
+
+/* A message with no binary type of its own. */
+static void out_text(OutBuf *out, ClientProto proto, const char *text) {
+    if (proto == PROTO_BINARY) {
+        wire_text(out, WIRE_TEXT, text);
+    } else {
+        outbuf_puts(out, text);
+    }
+}
+
+/* Text clients are told they are waiting; binary ones know from the missing WIRE_TURN_START. */
+static void out_waiting(OutBuf *out, ClientProto proto) {
+    if (proto != PROTO_BINARY) {
+        outbuf_puts(out, "Waiting for your turn...\n");
+    }
+}
+
+/* Join reply: greeting, rules and table fill for text; WIRE_WELCOME for binary. */
+static void out_welcome(OutBuf *out, ClientProto proto, int table, int seat, const char *name, int connected) {
+    if (proto == PROTO_BINARY) {
+        size_t at = wire_begin(out, WIRE_WELCOME);
+        wire_u8(out, (unsigned)seat);
+        wire_u32(out, (uint32_t)table);
+        wire_u8(out, (unsigned)connected);
+        wire_u8(out, (unsigned)game->target_players);
+        wire_u32(out, (uint32_t)board_size(&board));
+        wire_u8(out, (unsigned)board.cols);
+        wire_end(out, at);
+        return;
+    }
+    outbuf_printf(out, "Welcome %s! Waiting for the game to start...\n", name);
+    outbuf_printf(out, "Rules: first to reach %d wins (exact roll needed). Snakes down, ladders up.\n",
+                  board_size(&board));
+    outbuf_printf(out, "Table %d - players connected: %d/%d\n", table + 1, connected, game->target_players);
+    outbuf_puts(out, "Waiting for other players to join...\n");
+    if (proto == PROTO_DELTA) {
+        out_board_geometry(out);
+    }
+}
+
+/* Prompt for a roll, with the board when show_board (text: board_text, drawn by the caller). */
+static void out_your_turn(OutBuf *out, ClientProto proto, int show_board, const char *board_text) {
+    if (proto == PROTO_BINARY) {
+        size_t at = wire_begin(out, WIRE_TURN_START);
+        wire_u8(out, show_board ? WIRE_SHOW_BOARD : 0);
+        wire_end(out, at);
+        return;
+    }
+    if (show_board && proto == PROTO_DELTA) {
+        outbuf_puts(out, "@R\n");
+    } else if (show_board) {
+        outbuf_puts(out, "\n----- Board -----\n");
+        outbuf_puts(out, board_text);
+        outbuf_puts(out, "-----------------\n");
+    }
+    outbuf_puts(out, "YOUR_TURN: press ENTER to roll the dice.\n");
+}
+
+/* Add this connection's syscall counts to the shared totals. */
+static void publish_io_counts(LineBuf *in, OutBuf *out) {
+    __atomic_fetch_add(&game->recv_calls, in->recv_calls, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&game->send_calls, out->send_calls, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&game->send_bytes, out->send_bytes, __ATOMIC_RELAXED);
+    in->recv_calls = 0;
+    out->send_calls = 0;
+    out->send_bytes = 0;
+}
+
+/*
+ * Read the client's name, after an optional "@delta" or "@binary" line that
+ * picks the protocol. -1 if the client went away.
+ */
+static int read_join(LineBuf *in, char *name, size_t len, ClientProto *proto) {
+    *proto = PROTO_TEXT;
+    if (linebuf_read_line(in, name, len) < 0) {
+        return -1;
+    }
+    if (strcmp(name, "@delta") == 0) {
+        *proto = PROTO_DELTA;
+        return linebuf_read_line(in, name, len) < 0 ? -1 : 0;
+    }
+    if (strcmp(name, "@binary") != 0) {
+        return 0;
+    }
+
+    *proto = PROTO_BINARY;
+    uint8_t frame[LINEBUF_SIZE];
+    WireMsg m;
+    int n = wire_read(in, frame);
+    if (n < 0 || wire_decode(frame, (size_t)n, &m) != 0 || m.type != WIRE_JOIN) {
+        return -1;
+    }
+    size_t take = m.text_len < len - 1 ? m.text_len : len - 1;
+    memcpy(name, m.text, take);
+    name[take] = '\0';
+    return 0;
+}
+
+/*
+ * Take a roll out of what is already buffered: any line for text clients,
+ * WIRE_ROLL for binary ones. A resync request on the way resets sent so the
+ * next update is a full snapshot. 0 on a roll, 1 if none is buffered yet, -1
+ * on a bad frame.
+ */
+static int pop_roll(LineBuf *in, ClientProto proto, SentView *sent) {
+    for (;;) {
+        if (proto == PROTO_BINARY) {
+            uint8_t frame[LINEBUF_SIZE];
+            WireMsg m;
+            int n = wire_pop(in, frame);
+            if (n == WIRE_NOT_YET) {
+                return 1;
+            }
+            if (n < 0 || wire_decode(frame, (size_t)n, &m) != 0) {
+                return -1;
+            }
+            if (m.type == WIRE_ROLL) {
+                return 0;
+            }
+            if (m.type == WIRE_RESYNC) {
+                sent_view_reset(sent);
+            }
+        } else {
+            char line[512];
+            if (linebuf_pop(in, line, sizeof(line)) < 0) {
+                return 1;
+            }
+            if (strcmp(line, "@resync") != 0) {
+                return 0;
+            }
+            sent_view_reset(sent);
+        }
+    }
+}
+
+/*
+ * Wait for the roll until deadline_ms (0: no deadline). 0 on a roll, 1 if
+ * the deadline passed first, -1 if the client went away.
+ */
+static int read_roll(LineBuf *in, ClientProto proto, SentView *sent, long long deadline_ms) {
+    for (;;) {
+        int got = pop_roll(in, proto, sent);
+        if (got <= 0) {
+            return got;
+        }
+        int wait_ms = -1;
+        if (deadline_ms > 0) {
+            long long left = deadline_ms - now_ms();
+            if (left <= 0) {
+                return 1;
+            }
+            wait_ms = (int)left;
+        }
+        struct pollfd pfd;
+        pfd.fd = in->fd;
+        pfd.events = POLLIN;
+        int ready = poll(&pfd, 1, wait_ms);
+        if (ready < 0 && errno != EINTR) {
+            return -1;
+        }
+        if (ready > 0 && linebuf_fill(in) <= 0) {
+            return -1;
+        }
+    }
+}
+
+/* Throw away input sent before the prompt (a roll that came in after an auto-roll). */
+static void drop_stale_input(LineBuf *in) {
+    char junk[512];
+    in->head = 0;
+    in->len = 0;
+    while (recv(in->fd, junk, sizeof(junk), MSG_DONTWAIT) > 0) {
+    }
+}
+
+/*
+ * Fork mode: queue the other seats' moves since *seen, the way epoll mode
+ * fans them out (text gets the positions with the latest one, the others the
+ * changed positions). A child that fell more than MOVE_HISTORY moves behind
+ * skips the oldest; the positions still catch up.
+ */
+static void out_moves_locked(OutBuf *out, ClientProto proto, const GameTable *t, int id,
+                             unsigned *seen, SentView *sent) {
+    unsigned from = *seen;
+    if (t->move_seq - from > MOVE_HISTORY) {
+        from = t->move_seq - MOVE_HISTORY;
+    }
+    int shown = 0;
+    char pos_line[512];
+    for (unsigned s = from; s != t->move_seq; s++) {
+        const MoveRecord *m = &t->moves[s % MOVE_HISTORY];
+        if (m->seat == id) {
+            continue;   /* our own rolls are reported as we make them */
+        }
+        pos_line[0] = '\0';
+        if (proto == PROTO_TEXT && s + 1 == t->move_seq) {
+            build_positions_locked(t, pos_line, sizeof(pos_line));
+        }
+        out_turn_result(out, proto, m->seat, m->name, &m->result, pos_line);
+        shown = 1;
+    }
+    if (shown && proto != PROTO_TEXT) {
+        out_changes_locked(out, proto, t, sent);
+    }
+    *seen = t->move_seq;
+}
+
+static void handle_client(int sock, int table, int id) {
+    GameTable *t = &game->tables[table];
+    char buffer[512];
+    char board_local[BOARD_TEXT_MAX];
+    LineBuf in;
+    OutBuf out;
+    linebuf_init(&in, sock);
+    outbuf_init(&out, sock);
+
+    /* Ask for name and sanitize it a little. */
+    outbuf_puts(&out, "Enter your name (no spaces):\n");
+    outbuf_flush(&out);
+    ClientProto proto;
+    SentView sent;
+    sent_view_reset(&sent);
+    if (read_join(&in, buffer, sizeof(buffer), &proto) < 0) {
+        pthread_mutex_lock(&t->lock);
+        leave_table_locked(t, id);
+        pthread_mutex_unlock(&t->lock);
+        publish_io_counts(&in, &out);
+        outbuf_free(&out);
+        close(sock);
+        return;
+    }
+    for (int i = 0; buffer[i] != '\0'; i++) {
+        if (isspace((unsigned char)buffer[i])) {
+            buffer[i] = '_';
+        }
+    }
+    if (buffer[0] == '\0') {
+        snprintf(buffer, sizeof(buffer), "Player%d", id + 1);
+    }
+
+    /* Store the name in shared memory. */
+    pthread_mutex_lock(&t->lock);
+    strncpy(t->player_name[id], buffer, MAX_NAME - 1);
+    t->player_name[id][MAX_NAME - 1] = '\0';
+    t->roster_gen++;
+    int connected_now = t->active_players;
+    unsigned my_gen = t->seat_gen[id];
+    unsigned seen_moves = t->move_seq;
+    log_event(EV_JOIN, table, id, t->round_no, t->player_name[id]);
+    pthread_mutex_unlock(&t->lock);
+
+    /* Welcome text and waiting message. */
+    out_welcome(&out, proto, table, id, t->player_name[id], connected_now);
 
+    int game_started_notice = 0;
+    int game_over_notice = 0;
+    int my_turns = 0;
+    int stale_input = 0;
+    int waiting_notice = 0;
+    long long roll_ns = 0;
     while (server_running) {
-        pthread_mutex_lock(&game->state_mutex);
-
-        /* If game is over, just wake everyone so they can see the notice. */
-        if (game->game_over) {
-            if (game->game_over_notice != game->round_no) {
-                game->game_over_notice = game->round_no;
-                for (int i = 0; i < MAX_PLAYERS; i++) {
-                    if (game->connected[i]) {
-                        sem_post(&game->turn_sem[i]);
-                    }
-                }
+        /*
+         * Each loop waits for our semaphore (our turn, another seat's move or
+         * game over); everything queued goes out first.
+         */
+        if (!waiting_notice) {
+            out_waiting(&out, proto);
+            waiting_notice = 1;
+        }
+        if (outbuf_flush(&out) < 0) {
+            break;
+        }
+        if (roll_ns) {
+            hist_record(&my_metrics()->phase[PHASE_RESULT], now_ns() - roll_ns);
+            roll_ns = 0;
+        }
+        if (sem_wait(&t->turn_sem[id]) != 0) {
+            continue;
+        }
+
+        /* One look at the table per wakeup: game over, not started yet, or our turn. */
+        pthread_mutex_lock(&t->lock);
+        if (!t->connected[id] || t->seat_gen[id] != my_gen) {
+            pthread_mutex_unlock(&t->lock);
+            break;
+        }
+        out_moves_locked(&out, proto, t, id, &seen_moves, &sent);
+
+        /* If game finished, show winner and scoreboard once. */
+        if (t->game_over) {
+            int winner = t->winner_id;
+            char winner_name[MAX_NAME];
+            winner_name[0] = '\0';
+            if (winner >= 0 && winner < MAX_PLAYERS) {
+                strncpy(winner_name, t->player_name[winner], MAX_NAME - 1);
+                winner_name[MAX_NAME - 1] = '\0';
+            }
+            pthread_mutex_unlock(&t->lock);
+
+            if (!game_over_notice) {
+                ScoreView view;
+                score_view(&view);
+                out_game_over(&out, proto, winner, winner_name, &view, t->player_name[id]);
+                game_over_notice = 1;
+                game_started_notice = 0;
+                waiting_notice = 0;
+            }
+            continue;
+        }
+        game_over_notice = 0;
+
+        /* Still waiting for the scheduler to start the round, someone else's turn, or ours is done. */
+        if (!t->game_started || t->current_turn != id || t->turn_finished) {
+            pthread_mutex_unlock(&t->lock);
+            continue;
+        }
+        hist_record(&my_metrics()->phase[PHASE_WAKE], now_ns() - t->turn_signaled_ns);
+        note_round_start(t);
+
+        /* First time we get a turn, announce start. */
+        if (!game_started_notice) {
+            out_text(&out, proto, "Game started! Your turn will be announced.\n");
+            game_started_notice = 1;
+        }
+
+        /* Show the board every few turns. */
+        int show_board = my_turns == 0 || ((my_turns + 1) % t->board_show_every == 0);
+        if (proto != PROTO_TEXT) {
+            out_changes_locked(&out, proto, t, &sent);
+        } else if (show_board) {
+            build_board_locked(t, board_local, sizeof(board_local));
+        }
+        unsigned my_seq = t->turn_seq;
+        long long deadline_ms = t->turn_deadline_ms;
+        pthread_mutex_unlock(&t->lock);
+
+        if (stale_input) {
+            drop_stale_input(&in);
+            stale_input = 0;
+        }
+
+        /* Board and prompt leave in one send. */
+        out_your_turn(&out, proto, show_board, board_local);
+        int prompted = outbuf_flush(&out) >= 0;
+        long long prompt_ns = now_ns();
+        int got = prompted ? read_roll(&in, proto, &sent, deadline_ms) : -1;
+        while (got == 1) {
+            /* Past the deadline: the scheduler rolls for us. A roll that beats it still counts. */
+            pthread_mutex_lock(&t->lock);
+            int taken = t->turn_seq != my_seq || t->turn_finished;
+            pthread_mutex_unlock(&t->lock);
+            if (taken) {
+                break;
+            }
+            got = read_roll(&in, proto, &sent, now_ms() + TURN_TIMEOUT_POLL_MS);
+        }
+        if (got < 0) {
+            /* Client disconnected while waiting to roll (the seat may already be gone for idling). */
+            pthread_mutex_lock(&t->lock);
+            if (t->seat_gen[id] == my_gen && t->connected[id]) {
+                leave_table_locked(t, id);
+                log_event(EV_LEAVE, table, id, t->round_no, NULL);
+            }
+            pthread_mutex_unlock(&t->lock);
+            break;
+        }
+
+        /*
+         * Roll, snapshot positions and hand the turn back in one critical
+         * section, unless the scheduler already rolled for us; then we only
+         * report what it rolled.
+         */
+        TurnResult r;
+        char pos_line[512];
+        pos_line[0] = '\0';
+        pthread_mutex_lock(&t->lock);
+        int timed_out = got != 0 || t->turn_seq != my_seq || t->turn_finished;
+        int rolled = 1;
+        int dropped = 0;
+        if (timed_out) {
+            r = t->auto_result;
+            rolled = t->auto_seq == my_seq;
+            dropped = !t->connected[id] || t->seat_gen[id] != my_gen;
+            out_text(&out, proto, "Time's up! The server rolled for you.\n");
+        } else {
+            roll_ns = now_ns();
+            hist_record(&my_metrics()->phase[PHASE_THINK], roll_ns - prompt_ns);
+            apply_roll_locked(t, id, dice_roll(&t->dice), &r);
+            log_turn(table, t, id, &r);
+            note_move_locked(t, id, &r);
+            t->strikes[id] = 0;
+        }
+        if (rolled && proto != PROTO_TEXT) {
+            out_turn_result(&out, proto, id, t->player_name[id], &r, pos_line);
+            out_changes_locked(&out, proto, t, &sent);
+        } else if (rolled) {
+            build_positions_locked(t, pos_line, sizeof(pos_line));
+        }
+        if (!timed_out) {
+            t->turn_finished = 1;
+            t->turn_done_ns = now_ns();
+            wake_table_locked(t);
+        }
+        pthread_mutex_unlock(&t->lock);
+
+        /* The result is flushed with the next "Waiting" line at the top of the loop. */
+        if (rolled && proto == PROTO_TEXT) {
+            out_turn_result(&out, proto, id, t->player_name[id], &r, pos_line);
+        }
+        if (dropped) {
+            out_text(&out, proto, "You were removed from the table for not rolling.\n");
+            break;
+        }
+        stale_input = timed_out;
+        waiting_notice = 0;
+
+        my_turns++;
+        /* Publish our syscall counts so the parent can report them live. */
+        publish_io_counts(&in, &out);
+    }
+
+    /* Client cleanup. */
+    outbuf_flush(&out);
+    publish_io_counts(&in, &out);
+    outbuf_free(&out);
+    close(sock);
+}
+
+/* ---------------- epoll mode: one thread, many sockets ---------------- */
+
+/*
+ * The event thread is the only one that touches tables in this mode (there is
+ * no scheduler thread and no child process), so it calls the *_locked helpers
+ * without taking table locks. Only the scoreboard is shared with another thread.
+ *
+ * Sharded (-w N): N event threads, each pinned to a CPU with its own
+ * SO_REUSEPORT listener and its own slice of the tables. The loop state below
+ * is thread-local, every player is seated in a table of the shard that
+ * seats it, and a shard never touches another shard's tables, so turns
+ * take no lock shared between shards. Connections cross over instead: a
+ * spectator asking for another shard's table is handed to that shard (see
+ * ev_hand_over), and so is a new player when another shard has a table
+ * still gathering players (see ev_pick_shard).
+ */
+
+#define EV_MAX_EVENTS 256
+#define FRAME_QUEUE 256        /* frames queued per connection */
+#define FRAME_QUEUE_SHARED 192 /* past this, shared frames are skipped for that connection */
+#define FRAME_IOV 64           /* frames per writev */
+
+/*
+ * One encoded table update (a move, a round start, a result). It is built
+ * once and queued by reference on every subscriber, so fan-out costs a
+ * pointer and a refcount per connection; the last one to send it frees it.
+ */
+typedef struct {
+    int refs;
+    size_t len;
+    char data[];
+} Frame;
+
+/* Frames waiting to go out on one connection, oldest first. */
+typedef struct {
+    Frame *items[FRAME_QUEUE];
+    int head;
+    int count;
+    size_t off;               /* bytes of the oldest frame already sent */
+    unsigned long skipped;    /* shared frames dropped since the last notice */
+} FrameQueue;
+
+/* Per-connection state machine for the event loop. */
+typedef enum {
+    CONN_NAME,      /* waiting for the player's name */
+    CONN_WAITING,   /* seated, waiting for a turn */
+    CONN_ROLL,      /* YOUR_TURN sent, waiting for ENTER */
+    CONN_PICK,      /* spectator, waiting for a table number */
+    CONN_WATCHING,  /* spectator, receiving the table's frames */
+    CONN_MOVING,    /* spectator being handed to the shard that owns its table */
+    CONN_JOINING,   /* new player being handed to the shard that will seat it */
+    CONN_CLOSED     /* dropped; freed at the end of the loop pass */
+} ConnState;
+
+typedef struct Conn {
+    int fd;
+    int table;
+    int seat;                 /* -1 for spectators */
+    ConnState state;
+    int my_turns;
+    int started_notice;
+    int want_out;
+    ClientProto proto;
+    long long prompt_ns;      /* YOUR_TURN flushed, for the think phase */
+
+    LineBuf in;
+    OutBuf out;               /* private text; sealed into a frame once frames are queued */
+    FrameQueue frames;
+
+    struct Conn *watch_prev;  /* table's spectator list */
+    struct Conn *watch_next;
+    int dirty;                /* on the dirty list, flushed at the end of the loop pass */
+    struct Conn *next_dirty;
+    struct Conn *next_closed;
+    struct Conn *next_moving; /* CONN_MOVING, CONN_JOINING: this shard's outgoing list, then the owner's inbox */
+} Conn;
+
+/* One event thread of the server: its listeners and the tables it owns. */
+typedef struct {
+    int first_table;
+    int last_table;           /* one past the end */
+    int cpu;                  /* pinned to this CPU, -1 for none */
+    int listen_fd;            /* players (the shared server_fd when not sharded) */
+    int watch_fd;             /* spectators, -1 if the port was taken */
+    pthread_t thread;
+
+    /* Spectators and new players handed over by other shards, guarded by inbox_lock. */
+    pthread_mutex_t inbox_lock;
+    Conn *inbox;
+    int inbox_fd;             /* eventfd, readable while the inbox has news */
+
+    Metrics *metrics;         /* this shard's turns; summed by metrics_snapshot */
+    LogRing *log;             /* this shard's events; drained by the logger */
+} Shard;
+
+static Shard *shards = NULL;
+static int shard_count = 1;
+static int stop_fd = -1;      /* eventfd: readable once any shard has seen the shutdown */
+
+/* Indexed by table, so each shard only ever touches its own entries. */
+static Conn **seat_conn = NULL;   /* table_count * MAX_PLAYERS */
+static Conn **watchers = NULL;    /* table_count list heads */
+static unsigned char *roster_stale = NULL;   /* a player left since the last snapshot */
+
+/* Loop state of the calling event thread. */
+static __thread Shard *shard = NULL;
+static __thread int epoll_fd = -1;
+static __thread Conn *closed_conns = NULL;
+static __thread Conn *dirty_conns = NULL;
+static __thread Conn *moving_conns = NULL;
+static __thread int ev_open_conns = 0;
+static __thread int ev_peak_conns = 0;
+static __thread int ev_watchers = 0;
+static __thread int ev_peak_watchers = 0;
+
+/* Fan-out counters (event thread only). */
+static __thread unsigned long long frames_built = 0;
+static __thread unsigned long long frame_bytes = 0;
+static __thread unsigned long long frame_deliveries = 0;
+static __thread unsigned long long frame_skips = 0;
+static __thread long long fanout_ns = 0;       /* queueing frames on subscribers */
+static __thread long long fanout_send_ns = 0;  /* flushing the dirty list */
+static __thread unsigned long long fanout_sends = 0;
+
+/* The counters above, summed over the shards as they stop (for the shutdown stats). */
+typedef struct {
+    int peak_conns;
+    int peak_watchers;
+    unsigned long long frames_built;
+    unsigned long long frame_bytes;
+    unsigned long long frame_deliveries;
+    unsigned long long frame_skips;
+    long long fanout_ns;
+    long long fanout_send_ns;
+    unsigned long long fanout_sends;
+} EvTotals;
+
+static EvTotals ev_totals;
+static pthread_mutex_t ev_totals_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Rolls handled this loop pass; their result phase ends when the pass flushes. */
+static __thread long long pass_roll_ns[EV_MAX_EVENTS];
+static __thread int pass_rolls = 0;
+
+/* Scratch buffer that frames are formatted into before they are sealed. */
+static __thread OutBuf frame_text;
+
+static Conn *conn_at(int table, int seat) {
+    return seat_conn[table * MAX_PLAYERS + seat];
+}
+
+/* Still ours to read and write: not dropped, not handed to another shard. */
+static int conn_live(const Conn *c) {
+    return c->state != CONN_CLOSED && c->state != CONN_MOVING && c->state != CONN_JOINING;
+}
+
+/* Drop a connection: free its seat now, release the memory after the loop pass. */
+static void conn_kill(Conn *c) {
+    if (!conn_live(c)) {
+        return;
+    }
+    ConnState was = c->state;
+    c->state = CONN_CLOSED;
+    publish_io_counts(&c->in, &c->out);
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    ev_open_conns--;
+    c->next_closed = closed_conns;
+    closed_conns = c;
+
+    if (c->seat < 0) {
+        /* Spectator: leave the table's list; nobody waits on it. */
+        ev_watchers--;
+        if (was == CONN_WATCHING) {
+            if (c->watch_prev) {
+                c->watch_prev->watch_next = c->watch_next;
+            } else {
+                watchers[c->table] = c->watch_next;
+            }
+            if (c->watch_next) {
+                c->watch_next->watch_prev = c->watch_prev;
+            }
+        }
+        return;
+    }
+
+    GameTable *t = &game->tables[c->table];
+    seat_conn[c->table * MAX_PLAYERS + c->seat] = NULL;
+    leave_table_locked(t, c->seat);
+    if (was != CONN_NAME) {
+        log_event(EV_LEAVE, c->table, c->seat, t->round_no, NULL);
+        roster_stale[c->table] = 1;
+    }
+    /* The table gets rescheduled (new turn or pause) once the loop pass ends. */
+}
+
+static Frame *frame_new(const char *data, size_t len) {
+    Frame *f = malloc(sizeof(Frame) + len);
+    if (!f) {
+        return NULL;
+    }
+    f->refs = 1;
+    f->len = len;
+    memcpy(f->data, data, len);
+    return f;
+}
+
+static void frame_put(Frame *f) {
+    if (--f->refs == 0) {
+        free(f);
+    }
+}
+
+/* Turn what was formatted into frame_text into a frame (one reference, the caller's). */
+static Frame *frame_seal_text(void) {
+    Frame *f = frame_new(frame_text.data, frame_text.len);
+    frame_text.len = 0;
+    frame_text.off = 0;
+    if (f) {
+        frames_built++;
+        frame_bytes += f->len;
+    }
+    return f;
+}
+
+static int frames_push(FrameQueue *q, Frame *f) {
+    if (q->count == FRAME_QUEUE) {
+        return -1;
+    }
+    q->items[(q->head + q->count) % FRAME_QUEUE] = f;
+    q->count++;
+    f->refs++;
+    return 0;
+}
+
+/*
+ * Move the connection's unsent private text into its frame queue, so it keeps
+ * its place ahead of frames queued after it. -1 if the queue is full.
+ */
+static int conn_seal_text(Conn *c) {
+    size_t pending = outbuf_pending(&c->out);
+    if (pending == 0) {
+        return 0;
+    }
+    Frame *f = frame_new(c->out.data + c->out.off, pending);
+    if (!f) {
+        return -1;
+    }
+    int rc = frames_push(&c->frames, f);
+    frame_put(f);
+    c->out.off = 0;
+    c->out.len = 0;
+    return rc;
+}
+
+/* Flush this connection at the end of the loop pass. */
+static void conn_mark_dirty(Conn *c) {
+    if (!c->dirty) {
+        c->dirty = 1;
+        c->next_dirty = dirty_conns;
+        dirty_conns = c;
+    }
+}
+
+/*
+ * Queue a shared frame on a connection. Past FRAME_QUEUE_SHARED queued frames
+ * the connection is too slow: the frame is skipped (and counted) instead of
+ * buffering without bound, and the client is told once it catches up.
+ */
+static void conn_send_frame(Conn *c, Frame *f) {
+    FrameQueue *q = &c->frames;
+    if (q->count >= FRAME_QUEUE_SHARED) {
+        q->skipped++;
+        frame_skips++;
+        return;
+    }
+    if (conn_seal_text(c) != 0) {
+        conn_kill(c);
+        return;
+    }
+    if (q->skipped > 0) {
+        char notice[64];
+        snprintf(notice, sizeof(notice), "[%lu updates skipped: connection too slow]\n", q->skipped);
+        out_text(&c->out, c->proto, notice);
+        if (c->proto != PROTO_TEXT) {
+            out_snapshot_locked(&c->out, c->proto, &game->tables[c->table]);
+        }
+        q->skipped = 0;
+        if (conn_seal_text(c) != 0) {
+            conn_kill(c);
+            return;
+        }
+    }
+    frames_push(q, f);
+    frame_deliveries++;
+    conn_mark_dirty(c);
+}
+
+/* writev the queued frames: 0 when all went out, 1 when the socket is full, -1 on error. */
+static int frames_flush(Conn *c) {
+    FrameQueue *q = &c->frames;
+    while (q->count > 0) {
+        struct iovec iov[FRAME_IOV];
+        int n = 0;
+        for (int i = 0; i < q->count && n < FRAME_IOV; i++) {
+            Frame *f = q->items[(q->head + i) % FRAME_QUEUE];
+            size_t skip = i == 0 ? q->off : 0;
+            iov[n].iov_base = f->data + skip;
+            iov[n].iov_len = f->len - skip;
+            n++;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = (size_t)n;
+        ssize_t sent = sendmsg(c->fd, &msg, MSG_NOSIGNAL);
+        c->out.send_calls++;
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 1 : -1;
+        }
+
+        c->out.send_bytes += (unsigned long long)sent;
+        size_t left = (size_t)sent;
+        while (q->count > 0) {
+            Frame *f = q->items[q->head];
+            size_t rest = f->len - q->off;
+            if (left < rest) {
+                q->off += left;
+                break;
+            }
+            left -= rest;
+            q->off = 0;
+            q->head = (q->head + 1) % FRAME_QUEUE;
+            q->count--;
+            frame_put(f);
+        }
+    }
+    return 0;
+}
+
+/* Push queued output in one send; arm EPOLLOUT if the socket is full. */
+static void conn_flush(Conn *c) {
+    if (c->state == CONN_CLOSED) {
+        return;
+    }
+    int rc;
+    if (c->frames.count == 0) {
+        rc = outbuf_flush(&c->out);
+    } else if (conn_seal_text(c) != 0) {
+        rc = -1;
+    } else {
+        rc = frames_flush(c);
+    }
+    if (rc < 0) {
+        conn_kill(c);
+        return;
+    }
+
+    int want_out = rc > 0;
+    if (want_out != c->want_out) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP | (want_out ? EPOLLOUT : 0);
+        ev.data.ptr = c;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->want_out = want_out;
+    }
+}
+
+/* Send everything fan-out queued during this loop pass: one writev per connection. */
+static void flush_dirty(void) {
+    if (!dirty_conns) {
+        return;
+    }
+    long long start = now_ns();
+    while (dirty_conns) {
+        Conn *c = dirty_conns;
+        dirty_conns = c->next_dirty;
+        c->dirty = 0;
+        if (c->state != CONN_CLOSED) {
+            conn_flush(c);
+            fanout_sends++;
+        }
+    }
+    fanout_send_ns += now_ns() - start;
+}
+
+#define TO_PLAYERS 1
+#define TO_WATCHERS 2
+#define TO_ALL (TO_PLAYERS | TO_WATCHERS)
+
+/*
+ * One table update, encoded once per protocol: frames[p] goes to the
+ * connections speaking p among the players and/or spectators named by its
+ * TO_ flags. Two protocols may share a frame.
+ */
+typedef struct {
+    Frame *frames[PROTO_COUNT];
+    int to[PROTO_COUNT];
+} Update;
+
+/*
+ * Queue an update on the table's connections and drop the caller's
+ * references. Sending happens in flush_dirty, so several updates from one
+ * pass leave together and a slow socket never stalls the table.
+ */
+static void table_publish(int table, Update *u) {
+    long long start = now_ns();
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        Conn *c = conn_at(table, i);
+        if (c && (c->state == CONN_WAITING || c->state == CONN_ROLL) &&
+            u->frames[c->proto] && (u->to[c->proto] & TO_PLAYERS)) {
+            conn_send_frame(c, u->frames[c->proto]);
+        }
+    }
+    for (Conn *c = watchers[table]; c; c = c->watch_next) {
+        if (u->frames[c->proto] && (u->to[c->proto] & TO_WATCHERS)) {
+            conn_send_frame(c, u->frames[c->proto]);
+        }
+    }
+    for (int p = 0; p < PROTO_COUNT; p++) {
+        int first = u->frames[p] != NULL;
+        for (int q = 0; q < p && first; q++) {
+            first = u->frames[q] != u->frames[p];
+        }
+        if (first) {
+            frame_put(u->frames[p]);
+        }
+    }
+    fanout_ns += now_ns() - start;
+}
+
+/* Flush every live seat of a table (after fan-out). */
+static void flush_table(int table) {
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        Conn *c = conn_at(table, i);
+        if (c) {
+            conn_flush(c);
+        }
+    }
+}
+
+/* Scheduler picked this seat: show the board when due and ask for a roll. */
+static void ev_begin_turn(int table, int seat) {
+    GameTable *t = &game->tables[table];
+    Conn *c = conn_at(table, seat);
+    if (!c || c->state != CONN_WAITING) {
+        return;
+    }
+
+    if (!c->started_notice) {
+        out_text(&c->out, c->proto, "Game started! Your turn will be announced.\n");
+        c->started_notice = 1;
+    }
+    int show_board = c->my_turns == 0 || ((c->my_turns + 1) % t->board_show_every == 0);
+    char board_local[BOARD_TEXT_MAX];
+    board_local[0] = '\0';
+    if (show_board && c->proto == PROTO_TEXT) {
+        build_board_locked(t, board_local, sizeof(board_local));
+    }
+    out_your_turn(&c->out, c->proto, show_board, board_local);
+    c->state = CONN_ROLL;
+    conn_flush(c);
+    c->prompt_ns = now_ns();
+    note_round_start(t);
+}
+
+/* Show winner and scoreboard to every seat of the table. */
+static void ev_game_over(int table) {
+    GameTable *t = &game->tables[table];
+    int winner = t->winner_id;
+    const char *winner_name = (winner >= 0 && winner < MAX_PLAYERS) ? t->player_name[winner] : "";
+    ScoreView view;
+    score_hand_over();
+    score_view(&view);
+
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        Conn *c = conn_at(table, i);
+        if (!c || c->state == CONN_NAME) {
+            continue;
+        }
+        out_game_over(&c->out, c->proto, winner, winner_name, &view, t->player_name[i]);
+        out_waiting(&c->out, c->proto);
+        c->started_notice = 0;
+    }
+    flush_table(table);
+
+    if (watchers[table]) {
+        Update u = {{NULL}, {0}};
+        out_game_over(&frame_text, PROTO_TEXT, winner, winner_name, &view, "");
+        u.frames[PROTO_TEXT] = u.frames[PROTO_DELTA] = frame_seal_text();
+        u.to[PROTO_TEXT] = u.to[PROTO_DELTA] = TO_WATCHERS;
+        table_publish(table, &u);
+    }
+}
+
+/*
+ * New round: text spectators get a banner and the empty board; clients that
+ * draw their own board get one snapshot (players draw it at their turn).
+ */
+static void ev_round_start(int table) {
+    GameTable *t = &game->tables[table];
+    roster_stale[table] = 0;
+
+    Update u = {{NULL}, {0}};
+    if (watchers[table]) {
+        char board_local[BOARD_TEXT_MAX];
+        build_board_locked(t, board_local, sizeof(board_local));
+        outbuf_printf(&frame_text, "\nTable %d: round %u started\n----- Board -----\n", table + 1, t->round_no);
+        outbuf_puts(&frame_text, board_local);
+        outbuf_puts(&frame_text, "-----------------\n");
+        u.frames[PROTO_TEXT] = frame_seal_text();
+        u.to[PROTO_TEXT] = TO_WATCHERS;
+    }
+    outbuf_printf(&frame_text, "Table %d: round %u started\n", table + 1, t->round_no);
+    out_snapshot_locked(&frame_text, PROTO_DELTA, t);
+    u.frames[PROTO_DELTA] = frame_seal_text();
+    u.to[PROTO_DELTA] = TO_ALL;
+
+    size_t at = wire_begin(&frame_text, WIRE_ROUND_START);
+    wire_u32(&frame_text, (uint32_t)table);
+    wire_u32(&frame_text, t->round_no);
+    wire_end(&frame_text, at);
+    out_snapshot_locked(&frame_text, PROTO_BINARY, t);
+    u.frames[PROTO_BINARY] = frame_seal_text();
+    u.to[PROTO_BINARY] = TO_ALL;
+    table_publish(table, &u);
+}
+
+/* Player pressed ENTER (or timed_out: the deadline did): roll, report, and move the table on. */
+static void ev_roll(Conn *c, int timed_out) {
+    GameTable *t = &game->tables[c->table];
+    int id = c->seat;
+    TurnResult r;
+
+    long long roll_ns = now_ns();
+    if (!timed_out) {
+        hist_record(&my_metrics()->phase[PHASE_THINK], roll_ns - c->prompt_ns);
+        t->strikes[id] = 0;
+    }
+    if (pass_rolls < EV_MAX_EVENTS) {
+        pass_roll_ns[pass_rolls++] = roll_ns;
+    }
+    apply_roll_locked(t, id, dice_roll(&t->dice), &r);
+    log_turn(c->table, t, id, &r);
+
+    /*
+     * The move is formatted once per protocol and the same frame goes to the
+     * whole table: text with the positions line, or the changed position (a
+     * snapshot if someone left) for clients that draw the board.
+     */
+    Update u = {{NULL}, {TO_ALL, TO_ALL, TO_ALL}};
+    char pos_line[512];
+    build_positions_locked(t, pos_line, sizeof(pos_line));
+    out_turn_result(&frame_text, PROTO_TEXT, id, t->player_name[id], &r, pos_line);
+    u.frames[PROTO_TEXT] = frame_seal_text();
+    pos_line[0] = '\0';
+    for (int p = PROTO_DELTA; p < PROTO_COUNT; p++) {
+        out_turn_result(&frame_text, (ClientProto)p, id, t->player_name[id], &r, pos_line);
+        if (roster_stale[c->table]) {
+            out_snapshot_locked(&frame_text, (ClientProto)p, t);
+        } else {
+            out_positions_locked(&frame_text, (ClientProto)p, t, 1u << id);
+        }
+        u.frames[p] = frame_seal_text();
+    }
+    roster_stale[c->table] = 0;
+    table_publish(c->table, &u);
+    out_waiting(&c->out, c->proto);
+
+    c->my_turns++;
+    c->state = CONN_WAITING;
+    conn_mark_dirty(c);
+
+    t->turn_finished = 1;
+    t->turn_done_ns = now_ns();
+    schedule_table_locked(c->table);
+}
+
+/*
+ * A turn deadline ran out: roll for the player as if they had pressed ENTER,
+ * and drop them if that was one timeout too many. A seat that never got its
+ * prompt (still naming itself) is skipped instead.
+ */
+static void ev_turn_timeout(int table, int seat, int drop) {
+    GameTable *t = &game->tables[table];
+    Conn *c = conn_at(table, seat);
+    if (!c || c->state != CONN_ROLL) {
+        t->turn_finished = 1;
+        if (drop && c) {
+            conn_kill(c);
+        }
+        schedule_table_locked(table);
+        return;
+    }
+    out_text(&c->out, c->proto, "Time's up! The server rolled for you.\n");
+    ev_roll(c, 1);
+    if (drop) {
+        out_text(&c->out, c->proto, "You were removed from the table for not rolling.\n");
+        conn_flush(c);
+        conn_kill(c);
+    }
+}
+
+/* Name received: store it, greet the player and maybe start the table. */
+static void ev_set_name(Conn *c, char *line) {
+    GameTable *t = &game->tables[c->table];
+    int id = c->seat;
+
+    for (int i = 0; line[i] != '\0'; i++) {
+        if (isspace((unsigned char)line[i])) {
+            line[i] = '_';
+        }
+    }
+    if (line[0] == '\0') {
+        snprintf(t->player_name[id], MAX_NAME, "Player%d", id + 1);
+    } else {
+        strncpy(t->player_name[id], line, MAX_NAME - 1);
+        t->player_name[id][MAX_NAME - 1] = '\0';
+    }
+    t->roster_gen++;
+    roster_stale[c->table] = 1;
+
+    out_welcome(&c->out, c->proto, c->table, id, t->player_name[id], t->active_players);
+    if (c->proto != PROTO_TEXT) {
+        out_snapshot_locked(&c->out, c->proto, t);
+    }
+    out_waiting(&c->out, c->proto);
+    log_event(EV_JOIN, c->table, id, t->round_no, t->player_name[id]);
+    c->state = CONN_WAITING;
+    conn_flush(c);
+
+    /* Kick off the round once the table is full. */
+    if (!t->game_started && t->active_players >= game->target_players) {
+        reset_game_locked(t);
+        log_event(EV_ROUND_START, c->table, -1, t->round_no, NULL);
+        ev_round_start(c->table);
+    }
+    schedule_table_locked(c->table);
+}
+
+/* Subscribe a spectator to a table of this shard and send a snapshot of the game so far. */
+static void ev_watch_table(Conn *c, int table) {
+    c->table = table;
+    c->state = CONN_WATCHING;
+    c->watch_prev = NULL;
+    c->watch_next = watchers[table];
+    if (watchers[table]) {
+        watchers[table]->watch_prev = c;
+    }
+    watchers[table] = c;
+
+    GameTable *t = &game->tables[table];
+    outbuf_printf(&c->out, "Watching table %d.\n", table + 1);
+    if (c->proto == PROTO_DELTA) {
+        out_board_geometry(&c->out);
+        outbuf_printf(&c->out, "Round %u %s\n", t->round_no, t->game_started ? "in play" : "not started");
+        out_snapshot_locked(&c->out, c->proto, t);
+    } else if (t->game_started) {
+        char board_local[BOARD_TEXT_MAX];
+        char pos_line[512];
+        build_board_locked(t, board_local, sizeof(board_local));
+        build_positions_locked(t, pos_line, sizeof(pos_line));
+        outbuf_printf(&c->out, "Round %u in play\n----- Board -----\n", t->round_no);
+        outbuf_puts(&c->out, board_local);
+        outbuf_puts(&c->out, "-----------------\n");
+        outbuf_printf(&c->out, "Positions: %s\n", pos_line);
+    } else {
+        outbuf_puts(&c->out, "Waiting for the next round...\n");
+    }
+    conn_flush(c);
+}
+
+static Shard *shard_of(int table) {
+    return &shards[(long long)table * shard_count / game->table_count];
+}
+
+/*
+ * Hand a spectator to the shard that owns its table. It leaves this shard's
+ * epoll set now and is pushed to the owner's inbox at the end of the loop
+ * pass (ev_send_moving), once nothing in this pass can touch it any more.
+ */
+static void ev_hand_over(Conn *c, int table) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    ev_open_conns--;
+    ev_watchers--;
+    c->table = table;
+    c->state = CONN_MOVING;
+    c->next_moving = moving_conns;
+    moving_conns = c;
+}
+
+/* Push this pass's handed-over connections to their new shards and wake them. */
+static void ev_send_moving(void) {
+    while (moving_conns) {
+        Conn *c = moving_conns;
+        moving_conns = c->next_moving;
+        Shard *owner = shard_of(c->table);
+        pthread_mutex_lock(&owner->inbox_lock);
+        c->next_moving = owner->inbox;
+        owner->inbox = c;
+        pthread_mutex_unlock(&owner->inbox_lock);
+        uint64_t one = 1;
+        if (write(owner->inbox_fd, &one, sizeof(one)) < 0) {
+            perror("inbox");
+        }
+    }
+}
+
+/*
+ * Seat a new player in one of this shard's tables and ask for their name.
+ * c has its buffers set up and is not in any epoll set yet; it is freed if
+ * there is no seat.
+ */
+static void ev_seat_player(Conn *c) {
+    int table = -1;
+    int seat = -1;
+    if (find_open_seat(shard->first_table, shard->last_table, &table, &seat) != 0) {
+        send_line(c->fd, "Server full, try again later.\n");
+        close(c->fd);
+        outbuf_free(&c->out);
+        free(c);
+        return;
+    }
+    c->table = table;
+    c->seat = seat;
+    c->state = CONN_NAME;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = c;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->fd, &ev) != 0) {
+        leave_table_locked(&game->tables[table], seat);
+        close(c->fd);
+        outbuf_free(&c->out);
+        free(c);
+        return;
+    }
+
+    seat_conn[table * MAX_PLAYERS + seat] = c;
+    ev_open_conns++;
+    if (ev_open_conns > ev_peak_conns) {
+        ev_peak_conns = ev_open_conns;
+    }
+
+    outbuf_puts(&c->out, "Enter your name (no spaces):\n");
+    conn_flush(c);
+}
+
+/* Take in spectators and new players handed over by other shards. */
+static void ev_take_inbox(void) {
+    uint64_t n;
+    if (read(shard->inbox_fd, &n, sizeof(n)) < 0) {
+        return;
+    }
+    pthread_mutex_lock(&shard->inbox_lock);
+    Conn *c = shard->inbox;
+    shard->inbox = NULL;
+    pthread_mutex_unlock(&shard->inbox_lock);
+
+    while (c) {
+        Conn *next = c->next_moving;
+        if (c->state == CONN_JOINING) {
+            ev_seat_player(c);
+            c = next;
+            continue;
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP | (c->want_out ? EPOLLOUT : 0);
+        ev.data.ptr = c;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->fd, &ev) != 0) {
+            close(c->fd);
+            outbuf_free(&c->out);
+            free(c);
+        } else {
+            ev_open_conns++;
+            if (ev_open_conns > ev_peak_conns) {
+                ev_peak_conns = ev_open_conns;
+            }
+            ev_watchers++;
+            if (ev_watchers > ev_peak_watchers) {
+                ev_peak_watchers = ev_watchers;
+            }
+            ev_watch_table(c, c->table);
+        }
+        c = next;
+    }
+}
+
+/* Spectator chose a table: watch it here, or hand it to the shard that owns it. */
+static void ev_pick_table(Conn *c, const char *line) {
+    int table = -1;
+    if (line[0] == '\0') {
+        table = 0;
+        for (int i = 0; i < game->table_count; i++) {
+            if (__atomic_load_n(&game->tables[i].game_started, __ATOMIC_RELAXED)) {
+                table = i;
+                break;
+            }
+        }
+    } else {
+        char *end;
+        long n = strtol(line, &end, 10);
+        if (*end == '\0' && n >= 1 && n <= game->table_count) {
+            table = (int)n - 1;
+        }
+    }
+    if (table < 0) {
+        outbuf_printf(&c->out, "No such table. Table to watch (1-%d):\n", game->table_count);
+        conn_flush(c);
+        return;
+    }
+    if (shard_of(table) != shard) {
+        ev_hand_over(c, table);
+        return;
+    }
+    ev_watch_table(c, table);
+}
+
+/* Handle one buffered frame from a binary client: 1 if there was one. */
+static int ev_read_frame(Conn *c) {
+    uint8_t frame[LINEBUF_SIZE];
+    WireMsg m;
+    int n = wire_pop(&c->in, frame);
+    if (n == WIRE_NOT_YET) {
+        return 0;
+    }
+    if (n < 0 || wire_decode(frame, (size_t)n, &m) != 0) {
+        conn_kill(c);
+        return 0;
+    }
+    if (m.type == WIRE_JOIN && c->state == CONN_NAME) {
+        char name[MAX_NAME];
+        size_t take = m.text_len < sizeof(name) - 1 ? m.text_len : sizeof(name) - 1;
+        memcpy(name, m.text, take);
+        name[take] = '\0';
+        ev_set_name(c, name);
+    } else if (m.type == WIRE_ROLL && c->state == CONN_ROLL) {
+        ev_roll(c, 0);
+    } else if (m.type == WIRE_RESYNC && c->state != CONN_NAME) {
+        out_snapshot_locked(&c->out, c->proto, &game->tables[c->table]);
+        conn_flush(c);
+    }
+    return 1;
+}
+
+/* Pull everything the socket has, then feed complete lines to the state machine. */
+static void ev_read(Conn *c) {
+    char line[512];
+    for (;;) {
+        size_t room = sizeof(c->in.data) - c->in.len;
+        int n = linebuf_fill(&c->in);
+        /* ENOBUFS: a full buffer with nothing poppable in it, which only a bad peer can cause. */
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            conn_kill(c);
+            return;
+        }
+
+        while (conn_live(c) && c->proto == PROTO_BINARY && ev_read_frame(c)) {
+        }
+        while (conn_live(c) && c->proto != PROTO_BINARY &&
+               linebuf_pop(&c->in, line, sizeof(line)) >= 0) {
+            if (strcmp(line, "@delta") == 0 && (c->state == CONN_NAME || c->state == CONN_PICK)) {
+                c->proto = PROTO_DELTA;
+            } else if (strcmp(line, "@binary") == 0 && c->state == CONN_NAME) {
+                /* Everything after this line is frames; the loop above takes them. */
+                c->proto = PROTO_BINARY;
+                while (conn_live(c) && ev_read_frame(c)) {
+                }
+            } else if (strcmp(line, "@resync") == 0) {
+                if (c->proto != PROTO_TEXT && c->state != CONN_NAME && c->state != CONN_PICK) {
+                    out_snapshot_locked(&c->out, c->proto, &game->tables[c->table]);
+                    conn_flush(c);
+                }
+            } else if (c->state == CONN_NAME) {
+                ev_set_name(c, line);
+            } else if (c->state == CONN_ROLL) {
+                ev_roll(c, 0);
+            } else if (c->state == CONN_PICK) {
+                ev_pick_table(c, line);
+            }
+            /* Input while waiting is ignored. */
+        }
+        /* A short read means the socket is drained; epoll will tell us about more. */
+        if (!conn_live(c) || n < 0 || (size_t)n < room) {
+            return;
+        }
+    }
+}
+
+/* First table in first..last-1 a new player could sit at without waiting for a round to end. */
+static int peek_open_table(int first, int last, int gathering_only) {
+    for (int i = first; i < last; i++) {
+        const GameTable *t = &game->tables[i];
+        int active = __atomic_load_n(&t->active_players, __ATOMIC_RELAXED);
+        if (!__atomic_load_n(&t->game_started, __ATOMIC_RELAXED) && active < game->target_players &&
+            (active > 0 || !gathering_only)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Which shard should seat a new player. Matchmaking is global even though
+ * seating is not: a table anywhere that already has players waiting comes
+ * first (this shard's own before the others), then an empty table here,
+ * then one elsewhere. Otherwise players accepted by different shards could
+ * each sit alone at half-empty tables. Other shards' tables are only
+ * peeked at; their owner claims the seat when the player arrives, and falls
+ * back to its own empty tables if the one it was picked for has filled.
+ */
+static Shard *ev_pick_shard(void) {
+    for (int gathering_only = 1; gathering_only >= 0; gathering_only--) {
+        if (peek_open_table(shard->first_table, shard->last_table, gathering_only) >= 0) {
+            return shard;
+        }
+        for (int i = 0; i < shard_count; i++) {
+            Shard *s = &shards[i];
+            if (s != shard && peek_open_table(s->first_table, s->last_table, gathering_only) >= 0) {
+                return s;
+            }
+        }
+    }
+    return shard;
+}
+
+/* Accept every pending connection and seat it, here or in the shard ev_pick_shard chooses. */
+static void ev_accept(void) {
+    for (;;) {
+        int fd = accept4(shard->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK && server_running) {
+                perror("accept");
+            }
+            return;
+        }
+
+        Conn *c = calloc(1, sizeof(Conn));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->seat = -1;
+        linebuf_init(&c->in, fd);
+        outbuf_init(&c->out, fd);
+
+        Shard *to = shard_count > 1 ? ev_pick_shard() : shard;
+        if (to == shard) {
+            ev_seat_player(c);
+            continue;
+        }
+        /* Sent at the end of the pass with the spectators (ev_send_moving); shard_of(table) is to. */
+        c->table = to->first_table;
+        c->state = CONN_JOINING;
+        c->next_moving = moving_conns;
+        moving_conns = c;
+    }
+}
+
+/* Accept spectators on the watch port; they pick a table first. */
+static void ev_accept_watch(void) {
+    for (;;) {
+        int fd = accept4(shard->watch_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
             }
-            pthread_mutex_unlock(&game->state_mutex);
-            sleep(1);
-            continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK && server_running) {
+                perror("accept");
+            }
+            return;
         }
 
-        /* Wait until we have enough players and game is marked started. */
-        if (!game->game_started || game->active_players < MIN_PLAYERS) {
-            pthread_mutex_unlock(&game->state_mutex);
-            sleep(1);
+        Conn *c = calloc(1, sizeof(Conn));
+        if (!c) {
+            close(fd);
             continue;
         }
+        c->fd = fd;
+        c->table = 0;
+        c->seat = -1;
+        c->state = CONN_PICK;
+        linebuf_init(&c->in, fd);
+        outbuf_init(&c->out, fd);
 
-        /* New round: reset our turn pointer. */
-        if (game->round_no != last_round) {
-            last_round = game->round_no;
-            last_turn = -1;
-        }
-
-        /* Pick next player in order. */
-        int next = find_next_active_locked(last_turn);
-        if (next < 0) {
-            pthread_mutex_unlock(&game->state_mutex);
-            sleep(1);
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = c;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            free(c);
             continue;
         }
 
-        game->current_turn = next;
-        enqueue_log("Turn -> Player %d (%s)", next + 1,
-                    game->player_name[next][0] ? game->player_name[next] : "Player");
-        pthread_mutex_unlock(&game->state_mutex);
+        ev_open_conns++;
+        if (ev_open_conns > ev_peak_conns) {
+            ev_peak_conns = ev_open_conns;
+        }
+        ev_watchers++;
+        if (ev_watchers > ev_peak_watchers) {
+            ev_peak_watchers = ev_watchers;
+        }
 
-        /* Let that player take the turn. */
-        sem_post(&game->turn_sem[next]);
+        outbuf_printf(&c->out, "Table to watch (1-%d, ENTER = first table in play):\n", game->table_count);
+        conn_flush(c);
+    }
+}
 
-        /* Wait until client thread signals they finished. */
-        sem_wait(&game->turn_done);
-        last_turn = next;
+/*
+ * Open a listening socket; -1 (errno set) if the port is taken. Sharded,
+ * every shard binds its own with SO_REUSEPORT and the kernel spreads new
+ * connections over them by their address hash.
+ */
+static int open_listener(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (shard_count > 1) {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+    }
 
-        pthread_mutex_lock(&game->state_mutex);
-        /* Auto-restart a new round after a small pause. */
-        if (game->game_over && game->active_players >= MIN_PLAYERS) {
-            pthread_mutex_unlock(&game->state_mutex);
-            sleep(2);
-            pthread_mutex_lock(&game->state_mutex);
-            if (game->game_over && game->active_players >= MIN_PLAYERS) {
-                reset_game_locked();
-                enqueue_log("New game started (round %d)", game->round_no);
-            }
-        }
-        pthread_mutex_unlock(&game->state_mutex);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = INADDR_ANY;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
     }
-    return NULL;
+    return fd;
 }
 
-/* Read a line from the socket (newline-terminated). */
-static int recv_line(int sock, char *buf, size_t max_len) {
-    size_t idx = 0;
-    while (idx < max_len - 1) {
-        char c;
-        int n = recv(sock, &c, 1, 0);
-        if (n <= 0) {
-            return n;
+/* Release dropped connections and let their tables move on. */
+static void ev_reap_closed(void) {
+    while (closed_conns) {
+        Conn *c = closed_conns;
+        closed_conns = c->next_closed;
+        if (c->seat >= 0) {
+            schedule_table_locked(c->table);
         }
-        if (c == '\n') {
-            break;
+        if (c->dirty) {
+            Conn **link = &dirty_conns;
+            while (*link != c) {
+                link = &(*link)->next_dirty;
+            }
+            *link = c->next_dirty;
         }
-        if (c != '\r') {
-            buf[idx++] = c;
+        while (c->frames.count > 0) {
+            frame_put(c->frames.items[c->frames.head]);
+            c->frames.head = (c->frames.head + 1) % FRAME_QUEUE;
+            c->frames.count--;
         }
+        outbuf_free(&c->out);
+        free(c);
     }
-    buf[idx] = '\0';
-    return (int)idx;
 }
 
-/* Send a plain text line (already includes newline). */
-static void send_line(int sock, const char *msg) {
-    send(sock, msg, strlen(msg), 0);
+/* Add this shard's counters to the totals for the shutdown stats. */
+static void ev_publish_stats(void) {
+    pthread_mutex_lock(&ev_totals_lock);
+    ev_totals.peak_conns += ev_peak_conns;
+    ev_totals.peak_watchers += ev_peak_watchers;
+    ev_totals.frames_built += frames_built;
+    ev_totals.frame_bytes += frame_bytes;
+    ev_totals.frame_deliveries += frame_deliveries;
+    ev_totals.frame_skips += frame_skips;
+    ev_totals.fanout_ns += fanout_ns;
+    ev_totals.fanout_send_ns += fanout_send_ns;
+    ev_totals.fanout_sends += fanout_sends;
+    pthread_mutex_unlock(&ev_totals_lock);
 }
 
-/* Print scoreboard lines to the client. */
-static void send_scoreboard_lines(int sock, ScoreEntry *scores, int count) {
-    char line[128];
-    send_line(sock, "Scoreboard:\n");
-    if (count <= 0) {
-        send_line(sock, "  (no scores yet)\n");
+/* One shard's server loop: its listeners and every socket of its tables on one epoll set. */
+static void run_event_loop(Shard *s) {
+    shard = s;
+    thread_metrics = s->metrics;
+    thread_log = s->log;
+    log_wake_deferred = 1;
+    wins_deferred = 1;
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0 || wheel_init(&turn_wheel, TURN_WHEEL_SLOTS, TURN_WHEEL_TICK_MS, now_ms()) != 0) {
+        perror("epoll");
         return;
     }
-    for (int i = 0; i < count; i++) {
-        snprintf(line, sizeof(line), "  %d) %s - %d wins\n",
-                 i + 1, scores[i].name, scores[i].wins);
-        send_line(sock, line);
+
+    int flags = fcntl(s->listen_fd, F_GETFL, 0);
+    fcntl(s->listen_fd, F_SETFL, flags | O_NONBLOCK);
+    struct epoll_event lev;
+    lev.events = EPOLLIN;
+    lev.data.ptr = NULL;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, s->listen_fd, &lev);
+    if (s->watch_fd >= 0) {
+        lev.data.ptr = &s->watch_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, s->watch_fd, &lev);
     }
-}
+    if (s->inbox_fd >= 0) {
+        lev.data.ptr = &s->inbox_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, s->inbox_fd, &lev);
+    }
+    if (stop_fd >= 0) {
+        lev.data.ptr = &stop_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &lev);
+    }
+    outbuf_init(&frame_text, -1);
 
-static void handle_client(int sock, int id) {
-    char buffer[512];
-    char board_local[2048];
-    srand((unsigned int)(time(NULL) ^ (getpid() << 16)));
+    struct epoll_event events[EV_MAX_EVENTS];
+    while (server_running) {
+        /* Sleep until I/O, the next round pause or the next turn deadline, whichever is first. */
+        long long due = next_timer_due();
+        int timeout = -1;
+        if (due >= 0) {
+            long long wait = due - now_ms();
+            timeout = wait > 0 ? (int)wait : 0;
+        }
+        int n = epoll_wait(epoll_fd, events, EV_MAX_EVENTS, timeout);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
 
-    /* Ask for name and sanitize it a little. */
-    send_line(sock, "Enter your name (no spaces):\n");
-    int n = recv_line(sock, buffer, sizeof(buffer));
-    if (n <= 0) {
-        close(sock);
-        return;
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == &s->watch_fd) {
+                ev_accept_watch();
+                continue;
+            }
+            if (events[i].data.ptr == &s->inbox_fd) {
+                ev_take_inbox();
+                continue;
+            }
+            if (events[i].data.ptr == &stop_fd) {
+                continue;
+            }
+            Conn *c = events[i].data.ptr;
+            if (!c) {
+                ev_accept();
+                continue;
+            }
+            if (!conn_live(c)) {
+                continue;
+            }
+            if (events[i].events & EPOLLIN) {
+                ev_read(c);
+            }
+            if (conn_live(c) && (events[i].events & EPOLLOUT)) {
+                conn_flush(c);
+            }
+            if (conn_live(c) && (events[i].events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP))) {
+                conn_kill(c);
+            }
+        }
+        run_turn_timeouts();
+        ev_send_moving();
+        ev_reap_closed();
+        run_due_timers();
+        flush_dirty();
+        if (pass_rolls > 0) {
+            long long now = now_ns();
+            for (int i = 0; i < pass_rolls; i++) {
+                hist_record(&my_metrics()->phase[PHASE_RESULT], now - pass_roll_ns[i]);
+            }
+            pass_rolls = 0;
+        }
+        score_hand_over();
+        log_wake();
     }
-    for (int i = 0; buffer[i] != '\0'; i++) {
-        if (isspace((unsigned char)buffer[i])) {
-            buffer[i] = '_';
+    score_hand_over();
+    log_wake();
+
+    /* Count input syscalls of the connections still open. */
+    for (int i = s->first_table * MAX_PLAYERS; i < s->last_table * MAX_PLAYERS; i++) {
+        if (seat_conn[i]) {
+            publish_io_counts(&seat_conn[i]->in, &seat_conn[i]->out);
         }
     }
-    if (buffer[0] == '\0') {
-        snprintf(buffer, sizeof(buffer), "Player%d", id + 1);
+    for (int i = s->first_table; i < s->last_table; i++) {
+        for (Conn *c = watchers[i]; c; c = c->watch_next) {
+            publish_io_counts(&c->in, &c->out);
+        }
+    }
+    ev_publish_stats();
+    if (s->watch_fd >= 0) {
+        close(s->watch_fd);
     }
+    outbuf_free(&frame_text);
+    wheel_free(&turn_wheel);
+    close(epoll_fd);
+}
 
-    /* Store the name in shared memory. */
-    pthread_mutex_lock(&game->state_mutex);
-    strncpy(game->player_name[id], buffer, MAX_NAME - 1);
-    game->player_name[id][MAX_NAME - 1] = '\0';
-    pthread_mutex_unlock(&game->state_mutex);
+/* Shards other than the first run on their own thread, pinned to their CPU. */
+static void *shard_thread(void *arg) {
+    Shard *s = arg;
+    sigset_t block;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &block, NULL);
+    run_event_loop(s);
+    return NULL;
+}
 
-    /* Welcome text and waiting message. */
-    snprintf(buffer, sizeof(buffer), "Welcome %s! Waiting for the game to start...\n", game->player_name[id]);
-    send_line(sock, buffer);
-    send_line(sock, "Rules: first to reach 100 wins (exact roll needed). Snakes down, ladders up.\n");
-    pthread_mutex_lock(&game->state_mutex);
-    int connected_now = game->active_players;
-    int target_total = game->target_players;
-    pthread_mutex_unlock(&game->state_mutex);
-    snprintf(buffer, sizeof(buffer), "Players connected: %d/%d\n", connected_now, target_total);
-    send_line(sock, buffer);
-    send_line(sock, "Waiting for other players to join...\n");
-    enqueue_log("Player %d (%s) connected", id + 1, game->player_name[id]);
+static void pin_to_cpu(pthread_t thread, int cpu) {
+    if (cpu < 0) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int rc = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (rc != 0) {
+        fprintf(stderr, "pin to cpu %d: %s\n", cpu, strerror(rc));
+    }
+}
 
-    int game_started_notice = 0;
-    int game_over_notice = 0;
-    int my_turns = 0;
-    while (server_running) {
-        /* Each loop waits for our turn semaphore. */
-        send_line(sock, "Waiting for your turn...\n");
-        if (sem_wait(&game->turn_sem[id]) != 0) {
-            continue;
-        }
+/*
+ * Split the tables over the shards, open each shard's listeners and assign
+ * CPUs round-robin over the ones this process may run on. The first shard
+ * listens on server_fd. -1 if a listener could not be opened.
+ */
+static int setup_shards(void) {
+    int n = game->table_count;
+    Shard *list = calloc((size_t)shard_count, sizeof(Shard));
+    seat_conn = calloc((size_t)n * MAX_PLAYERS, sizeof(Conn *));
+    watchers = calloc((size_t)n, sizeof(Conn *));
+    roster_stale = calloc((size_t)n, 1);
+    if (!list || !seat_conn || !watchers || !roster_stale) {
+        perror("calloc");
+        return -1;
+    }
 
-        pthread_mutex_lock(&game->state_mutex);
-        if (!game->connected[id]) {
-            pthread_mutex_unlock(&game->state_mutex);
-            break;
-        }
-        if (!game->game_over) {
-            game_over_notice = 0;
+    cpu_set_t allowed;
+    int cpus[CPU_SETSIZE];
+    int cpu_count = 0;
+    if (shard_count > 1 && sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &allowed)) {
+                cpus[cpu_count++] = c;
+            }
         }
+    }
 
-        /* If game finished, show winner and scoreboard once. */
-        if (game->game_over) {
-            int winner = game->winner_id;
-            char winner_name[MAX_NAME];
-            winner_name[0] = '\0';
-            if (winner >= 0 && winner < MAX_PLAYERS) {
-                strncpy(winner_name, game->player_name[winner], MAX_NAME - 1);
-                winner_name[MAX_NAME - 1] = '\0';
+    int watching = 0;
+    for (int i = 0; i < shard_count; i++) {
+        Shard *s = &list[i];
+        s->first_table = (int)((long long)i * n / shard_count);
+        s->last_table = (int)((long long)(i + 1) * n / shard_count);
+        s->cpu = cpu_count > 0 ? cpus[i % cpu_count] : -1;
+        s->listen_fd = i == 0 ? server_fd : open_listener(PORT);
+        if (s->listen_fd < 0) {
+            perror("bind");
+            return -1;
+        }
+        s->watch_fd = open_listener(WATCH_PORT);
+        watching += s->watch_fd >= 0;
+        pthread_mutex_init(&s->inbox_lock, NULL);
+        s->inbox_fd = shard_count > 1 ? eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC) : -1;
+        if (shard_count > 1) {
+            /* Cache-line aligned so neighbouring shards' counters never share a line. */
+            size_t bytes = (sizeof(Metrics) + 63) & ~(size_t)63;
+            s->metrics = aligned_alloc(64, bytes);
+            if (!s->metrics) {
+                perror("aligned_alloc");
+                return -1;
             }
+            memset(s->metrics, 0, bytes);
 
-            ScoreEntry scores_local[SCORE_MAX];
-            int score_count_local = game->score_count;
-            if (score_count_local > SCORE_MAX) {
-                score_count_local = SCORE_MAX;
+            /* Its own log ring too, the same size as the shared one. */
+            size_t ring_bytes = (sizeof(LogRing) + 63) & ~(size_t)63;
+            s->log = aligned_alloc(64, ring_bytes);
+            LogSlot *slots = aligned_alloc(64, (game->log.mask + 1) * sizeof(LogSlot));
+            if (!s->log || !slots) {
+                perror("aligned_alloc");
+                return -1;
             }
-            for (int i = 0; i < score_count_local; i++) {
-                scores_local[i] = game->scores[i];
+            memset(s->log, 0, ring_bytes);
+            s->log->slots = slots;
+            s->log->mask = game->log.mask;
+            for (unsigned long j = 0; j <= s->log->mask; j++) {
+                slots[j].seq = j;
             }
-            pthread_mutex_unlock(&game->state_mutex);
+        }
+    }
+    if (watching == shard_count) {
+        printf("Spectators: port %d\n", WATCH_PORT);
+    } else {
+        perror("watch port");
+    }
+    if (shard_count > 1) {
+        stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        printf("Shards: %d event threads, %d tables each, one SO_REUSEPORT listener per shard\n",
+               shard_count, n / shard_count);
+    }
+    /* The metrics and logger threads are already running; they only see finished shards. */
+    if (shard_count > 1) {
+        LogRing **logs = calloc((size_t)shard_count, sizeof(LogRing *));
+        if (!logs) {
+            perror("calloc");
+            return -1;
+        }
+        for (int i = 0; i < shard_count; i++) {
+            logs[i] = list[i].log;
+        }
+        shard_log_count = shard_count;
+        __atomic_store_n(&shard_logs, logs, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&shards, list, __ATOMIC_RELEASE);
+    fflush(stdout);
+    return 0;
+}
 
-            if (!game_over_notice) {
-                send_line(sock, "\n==============================\n");
-                if (winner_name[0]) {
-                    snprintf(buffer, sizeof(buffer), "WINNER: %s\n", winner_name);
-                    send_line(sock, buffer);
-                } else {
-                    send_line(sock, "GAME OVER\n");
-                }
-                send_line(sock, "==============================\n");
-                send_scoreboard_lines(sock, scores_local, score_count_local);
-                game_over_notice = 1;
-                game_started_notice = 0;
+/* Run every shard: the others on their own threads, the first on this one. */
+static void run_shards(void) {
+    for (int i = 1; i < shard_count; i++) {
+        pthread_create(&shards[i].thread, NULL, shard_thread, &shards[i]);
+        pin_to_cpu(shards[i].thread, shards[i].cpu);
+    }
+    pin_to_cpu(pthread_self(), shards[0].cpu);
+    run_event_loop(&shards[0]);
+
+    /* Whichever shard saw the shutdown first, make sure the rest wake up too. */
+    if (stop_fd >= 0) {
+        uint64_t one = 1;
+        if (write(stop_fd, &one, sizeof(one)) < 0) {
+            perror("stop");
+        }
+    }
+    for (int i = 1; i < shard_count; i++) {
+        pthread_join(shards[i].thread, NULL);
+        close(shards[i].listen_fd);
+    }
+}
+
+/* Keep accepting and matching clients into tables, forking a child per client. */
+static void run_fork_server(void) {
+    while (server_running) {
+        int client_fd = accept(server_fd, NULL, NULL);
+        if (client_fd < 0) {
+            if (server_running && errno != EINTR) {
+                perror("accept");
             }
             continue;
         }
 
-        /* Still waiting for the scheduler to start the round. */
-        if (!game->game_started) {
-            pthread_mutex_unlock(&game->state_mutex);
+        int table = -1;
+        int seat = -1;
+        if (find_open_seat(0, game->table_count, &table, &seat) != 0) {
+            send_line(client_fd, "Server full, try again later.\n");
+            close(client_fd);
             continue;
         }
+        GameTable *t = &game->tables[table];
 
-        int my_turn = (game->current_turn == id);
-        pthread_mutex_unlock(&game->state_mutex);
-
-        if (!my_turn) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            pthread_mutex_lock(&t->lock);
+            leave_table_locked(t, seat);
+            pthread_mutex_unlock(&t->lock);
+            close(client_fd);
             continue;
         }
+        if (pid == 0) {
+            close(server_fd);
+            if (metrics_fd >= 0) {
+                close(metrics_fd);
+            }
+            handle_client(client_fd, table, seat);
+            exit(0);
+        }
 
-        /* First time we get a turn, announce start. */
-        if (!game_started_notice) {
-            send_line(sock, "Game started! Your turn will be announced.\n");
-            game_started_notice = 1;
+        close(client_fd);
+
+        /* Kick off the round once the table is full. */
+        pthread_mutex_lock(&t->lock);
+        if (!t->game_started && t->active_players >= game->target_players) {
+            reset_game_locked(t);
+            log_event(EV_ROUND_START, table, -1, t->round_no, NULL);
+            wake_table_locked(t);
         }
+        pthread_mutex_unlock(&t->lock);
+    }
+}
 
-        /* Show the board every few turns. */
-        if (my_turns == 0 || ((my_turns + 1) % game->board_show_every == 0)) {
-            pthread_mutex_lock(&game->state_mutex);
-            build_board_locked(board_local, sizeof(board_local));
-            pthread_mutex_unlock(&game->state_mutex);
-            send_line(sock, "\n----- Board -----\n");
-            send_line(sock, board_local);
-            send_line(sock, "-----------------\n");
-        }
-
-        send_line(sock, "YOUR_TURN: press ENTER to roll the dice.\n");
-        n = recv_line(sock, buffer, sizeof(buffer));
-        if (n <= 0) {
-            /* Client disconnected while waiting to roll. */
-            pthread_mutex_lock(&game->state_mutex);
-            game->connected[id] = 0;
-            game->active_players--;
-            pthread_mutex_unlock(&game->state_mutex);
-            enqueue_log("Player %d (%s) disconnected", id + 1, game->player_name[id]);
-            sem_post(&game->turn_done);
-            break;
+static double tv_us(const struct timeval *tv) {
+    return (double)tv->tv_sec * 1e6 + (double)tv->tv_usec;
+}
+
+/* The shared metrics plus every shard's own, as of now. */
+static void metrics_snapshot(Metrics *m) {
+    memset(m, 0, sizeof(*m));
+    metrics_add(m, &game->metrics);
+    const Shard *list = __atomic_load_n(&shards, __ATOMIC_ACQUIRE);
+    for (int i = 0; list && i < shard_count; i++) {
+        if (list[i].metrics) {
+            metrics_add(m, list[i].metrics);
         }
+    }
+}
 
-        /* Roll and apply rules inside shared state lock. */
-        pthread_mutex_lock(&game->state_mutex);
-        int dice = (rand() % 6) + 1;
-        int before = game->position[id];
-        int moved = 0;
-        int after = before;
-        int hit_snake = 0;
-        int hit_ladder = 0;
-        int jump_from = 0;
-        int jump_to = 0;
-        /* No broadcast for board; only per-player display. */
-
-        if (before + dice <= BOARD_SIZE) {
-            moved = 1;
-            after = before + dice;
-            int adjusted = apply_snakes_ladders(after);
-            if (adjusted != after) {
-                if (adjusted < after) {
-                    hit_snake = 1;
-                } else {
-                    hit_ladder = 1;
-                }
-                jump_from = after;
-                jump_to = adjusted;
-                after = adjusted;
-            }
-            game->position[id] = after;
+/* Context switches and turns, to compare the fork and epoll models. */
+static void print_run_stats(void) {
+    struct rusage self;
+    struct rusage kids;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &kids);
+    long switches = self.ru_nvcsw + self.ru_nivcsw + kids.ru_nvcsw + kids.ru_nivcsw;
+    double cpu_us = tv_us(&self.ru_utime) + tv_us(&self.ru_stime) + tv_us(&kids.ru_utime) + tv_us(&kids.ru_stime);
+    Metrics m;
+    metrics_snapshot(&m);
+    long long turns = (long long)m.turns;
+
+    if (shard_count > 1) {
+        printf("Mode: epoll, %d shards\n", shard_count);
+    } else {
+        printf("Mode: %s\n", event_mode ? "epoll" : "fork");
+    }
+    printf("Turns played: %lld\n", turns);
+    printf("recv() calls: %llu (%.2f per turn)\n", game->recv_calls,
+           turns > 0 ? (double)game->recv_calls / (double)turns : 0.0);
+    printf("send() calls: %llu (%.2f per turn), %llu bytes (%.1f per turn)\n", game->send_calls,
+           turns > 0 ? (double)game->send_calls / (double)turns : 0.0, game->send_bytes,
+           turns > 0 ? (double)game->send_bytes / (double)turns : 0.0);
+    printf("Round start latency: p50 %.1f us, p99 %.1f us, max %.1f us over %llu rounds\n",
+           (double)hist_quantile(&m.round_start, 0.5) / 1000.0,
+           (double)hist_quantile(&m.round_start, 0.99) / 1000.0, (double)m.round_start.max / 1000.0,
+           m.round_start.count);
+    double uptime_s = (double)(now_ns() - started_ns) / 1e9;
+    printf("Log: %llu events in %llu batches (%.1f events/batch), %llu syncs, %.0f events/s\n",
+           log_lines, log_batches,
+           log_batches > 0 ? (double)log_lines / (double)log_batches : 0.0,
+           log_syncs, uptime_s > 0 ? (double)log_lines / uptime_s : 0.0);
+    printf("Log size: %llu bytes (%.1f bytes/event, %.1f bytes/turn)\n", log_bytes,
+           log_lines > 0 ? (double)log_bytes / (double)log_lines : 0.0,
+           turns > 0 ? (double)log_bytes / (double)turns : 0.0);
+    printf("Log messages dropped (ring full): %llu\n",
+           __atomic_load_n(&game->log_dropped, __ATOMIC_RELAXED));
+    printf("Log cost: %.2f us of logger time per turn\n",
+           turns > 0 ? (double)log_busy_ns / (double)turns / 1000.0 : 0.0);
+    printf("Scores: %d players, %llu wins journaled in %llu appends, %llu compactions\n",
+           scores.hdr->count, journal_wins, journal_appends, score_compactions);
+    if (scores.hdr->full_drops > 0) {
+        printf("Scoreboard full (%d players): %d wins not counted\n", scores.hdr->cap,
+               scores.hdr->full_drops);
+    }
+    printf("Recorded: %llu rounds in %llu records, %llu bytes (%.2f bytes/turn)\n",
+           game->rec_rounds, game->rec_records, game->rec_bytes,
+           turns > 0 ? (double)game->rec_bytes / (double)turns : 0.0);
+    if (game->rec_errors > 0) {
+        printf("Recording write errors: %llu\n", game->rec_errors);
+    }
+    printf("Context switches: %ld (%.2f per turn)\n", switches,
+           turns > 0 ? (double)switches / (double)turns : 0.0);
+    printf("Server CPU: %.3f s (%.1f us per turn)\n", cpu_us / 1e6,
+           turns > 0 ? cpu_us / (double)turns : 0.0);
+    if (m.timeouts > 0) {
+        printf("Turn timeouts: %llu auto-rolls, %llu players dropped for idling\n", m.timeouts, m.idle_drops);
+    }
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        const Histogram *h = &m.phase[p];
+        if (h->count == 0) {
+            continue;
         }
+        printf("Turn phase %-6s p50 %.1f us, p99 %.1f us, max %.1f us over %llu turns\n", turn_phase_name[p],
+               (double)hist_quantile(h, 0.5) / 1000.0, (double)hist_quantile(h, 0.99) / 1000.0,
+               (double)h->max / 1000.0, h->count);
+    }
+    if (event_mode) {
+        const EvTotals *e = &ev_totals;
+        printf("Peak sockets on the event %s: %d\n", shard_count > 1 ? "threads (sum of shards)" : "thread",
+               e->peak_conns);
+        printf("Fan-out: %llu frames (%.1f bytes avg), %llu deliveries to a peak of %d spectators, %llu skipped\n",
+               e->frames_built, e->frames_built > 0 ? (double)e->frame_bytes / (double)e->frames_built : 0.0,
+               e->frame_deliveries, e->peak_watchers, e->frame_skips);
+        printf("Fan-out cost per 1000 deliveries: %.1f us queueing, %.1f us sending (%llu flushes)\n",
+               e->frame_deliveries > 0 ? (double)e->fanout_ns / (double)e->frame_deliveries : 0.0,
+               e->frame_deliveries > 0 ? (double)e->fanout_send_ns / (double)e->frame_deliveries : 0.0,
+               e->fanout_sends);
+    }
+}
 
-        game->turn_count++;
+/* Everything in Metrics plus the log drop count, as Prometheus text. */
+static void write_metrics(OutBuf *out) {
+    Metrics snap;
+    metrics_snapshot(&snap);
+    const Metrics *m = &snap;
+    char label[32];
 
-        snprintf(buffer, sizeof(buffer), "Player %s rolled %d -> position %d\n",
-                 game->player_name[id], dice, game->position[id]);
-        pthread_mutex_unlock(&game->state_mutex);
+    outbuf_puts(out, "# HELP snl_turn_phase_seconds Time spent in each phase of a turn.\n");
+    outbuf_puts(out, "# TYPE snl_turn_phase_seconds histogram\n");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        snprintf(label, sizeof(label), "phase=\"%s\"", turn_phase_name[p]);
+        metrics_write_histogram(out, "snl_turn_phase_seconds", label, &m->phase[p]);
+    }
+    outbuf_puts(out, "# HELP snl_turn_phase_quantile_seconds Turn phase percentiles from the same histograms.\n");
+    outbuf_puts(out, "# TYPE snl_turn_phase_quantile_seconds gauge\n");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        snprintf(label, sizeof(label), "phase=\"%s\"", turn_phase_name[p]);
+        metrics_write_quantiles(out, "snl_turn_phase_quantile_seconds", label, &m->phase[p]);
+    }
 
-        send_line(sock, buffer);
-        enqueue_log("%s", buffer);
+    outbuf_puts(out, "# HELP snl_round_start_seconds Time from a table filling (or its pause ending) to the first YOUR_TURN.\n");
+    outbuf_puts(out, "# TYPE snl_round_start_seconds histogram\n");
+    metrics_write_histogram(out, "snl_round_start_seconds", "", &m->round_start);
+    outbuf_puts(out, "# HELP snl_round_start_quantile_seconds Round start percentiles from the same histogram.\n");
+    outbuf_puts(out, "# TYPE snl_round_start_quantile_seconds gauge\n");
+    metrics_write_quantiles(out, "snl_round_start_quantile_seconds", "", &m->round_start);
 
-        /* Extra messages for special cases. */
-        if (!moved) {
-            send_line(sock, "Exact roll needed to reach 100. You stay in place.\n");
-            enqueue_log("Player %s needed exact roll (stayed at %d)", game->player_name[id], before);
-        }
-        if (hit_snake) {
-            snprintf(buffer, sizeof(buffer), "Snake! %d -> %d\n", jump_from, jump_to);
-            send_line(sock, buffer);
-            enqueue_log("Player %s hit a snake (%d -> %d)", game->player_name[id], jump_from, jump_to);
-        } else if (hit_ladder) {
-            snprintf(buffer, sizeof(buffer), "Ladder! %d -> %d\n", jump_from, jump_to);
-            send_line(sock, buffer);
-            enqueue_log("Player %s climbed a ladder (%d -> %d)", game->player_name[id], jump_from, jump_to);
-        }
+    outbuf_puts(out, "# HELP snl_turns_total Turns played.\n# TYPE snl_turns_total counter\n");
+    outbuf_printf(out, "snl_turns_total %llu\n", __atomic_load_n(&m->turns, __ATOMIC_RELAXED));
+    outbuf_puts(out, "# HELP snl_wins_total Rounds won.\n# TYPE snl_wins_total counter\n");
+    outbuf_printf(out, "snl_wins_total %llu\n", __atomic_load_n(&m->wins, __ATOMIC_RELAXED));
+    outbuf_puts(out, "# HELP snl_disconnects_total Players who left their table.\n"
+                     "# TYPE snl_disconnects_total counter\n");
+    outbuf_printf(out, "snl_disconnects_total %llu\n", __atomic_load_n(&m->disconnects, __ATOMIC_RELAXED));
+    outbuf_puts(out, "# HELP snl_turn_timeouts_total Turns the server rolled for a player who ran out of time.\n"
+                     "# TYPE snl_turn_timeouts_total counter\n");
+    outbuf_printf(out, "snl_turn_timeouts_total %llu\n", __atomic_load_n(&m->timeouts, __ATOMIC_RELAXED));
+    outbuf_puts(out, "# HELP snl_idle_drops_total Players removed after too many timeouts in a row.\n"
+                     "# TYPE snl_idle_drops_total counter\n");
+    outbuf_printf(out, "snl_idle_drops_total %llu\n", __atomic_load_n(&m->idle_drops, __ATOMIC_RELAXED));
+    outbuf_puts(out, "# HELP snl_log_dropped_total game.log events dropped because the ring was full.\n"
+                     "# TYPE snl_log_dropped_total counter\n");
+    outbuf_printf(out, "snl_log_dropped_total %llu\n", __atomic_load_n(&game->log_dropped, __ATOMIC_RELAXED));
+    outbuf_puts(out, "# HELP snl_scoreboard_players Players on the scoreboard.\n"
+                     "# TYPE snl_scoreboard_players gauge\n");
+    outbuf_printf(out, "snl_scoreboard_players %d\n", __atomic_load_n(&scores.hdr->count, __ATOMIC_RELAXED));
+    outbuf_puts(out, "# HELP snl_scoreboard_full_drops_total Wins not counted because the scoreboard was full.\n"
+                     "# TYPE snl_scoreboard_full_drops_total counter\n");
+    outbuf_printf(out, "snl_scoreboard_full_drops_total %d\n",
+                  __atomic_load_n(&scores.hdr->full_drops, __ATOMIC_RELAXED));
+    outbuf_puts(out, "# HELP snl_uptime_seconds Time since the server started.\n# TYPE snl_uptime_seconds gauge\n");
+    outbuf_printf(out, "snl_uptime_seconds %.3f\n", (double)(now_ns() - started_ns) / 1e9);
+}
 
-        /* Show positions after the move. */
-        pthread_mutex_lock(&game->state_mutex);
-        char pos_line[512];
-        build_positions_locked(pos_line, sizeof(pos_line));
-        pthread_mutex_unlock(&game->state_mutex);
-        if (pos_line[0]) {
-            send_line(sock, "Positions: ");
-            send_line(sock, pos_line);
-            send_line(sock, "\n");
-        }
+/* Listen on the metrics socket; a stale socket file from an earlier run is replaced. */
+static int open_metrics_socket(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
 
-        /* Check win condition and update scores. */
-        pthread_mutex_lock(&game->state_mutex);
-        if (game->position[id] == BOARD_SIZE && !game->game_over) {
-            game->game_over = 1;
-            game->winner_id = id;
-            update_score_locked(game->player_name[id]);
-            save_scores_file();
-            snprintf(buffer, sizeof(buffer), "Player %s WON the game\n", game->player_name[id]);
-            enqueue_log("Player %s WON the game", game->player_name[id]);
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            errno = EEXIST;
+            return -1;
         }
-        pthread_mutex_unlock(&game->state_mutex);
+        unlink(path);
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
 
-        /* Send win line after releasing lock. */
-        if (buffer[0] != '\0' && strstr(buffer, "WON") != NULL) {
-            send_line(sock, buffer);
+/*
+ * Metrics thread: every connection to the metrics socket gets one snapshot
+ * and is closed (nc -U metrics.sock). It only reads the shared counters, so
+ * a scrape never touches a table lock.
+ */
+static void *metrics_thread(void *arg) {
+    (void)arg;
+    struct pollfd pfd;
+    pfd.fd = metrics_fd;
+    pfd.events = POLLIN;
+    while (server_running) {
+        if (poll(&pfd, 1, 200) <= 0) {
+            continue;
         }
-
-        my_turns++;
-        /* Tell scheduler we're done. */
-        sem_post(&game->turn_done);
+        int fd = accept(metrics_fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        struct timeval tv = {1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        OutBuf out;
+        outbuf_init(&out, fd);
+        write_metrics(&out);
+        outbuf_flush(&out);
+        outbuf_free(&out);
+        close(fd);
     }
-
-    /* Client cleanup. */
-    close(sock);
+    return NULL;
 }
 
 /* Reap child processes to avoid zombies. */
@@ -690,83 +3771,338 @@ static void handle_sigint(int sig) {
         close(server_fd);
         server_fd = -1;
     }
+    if (stop_fd >= 0) {
+        uint64_t one = 1;
+        if (write(stop_fd, &one, sizeof(one)) < 0) {
+            /* Already readable: every shard is on its way out. */
+        }
+    }
     if (game) {
-        for (int i = 0; i < MAX_PLAYERS; i++) {
-            sem_post(&game->turn_sem[i]);
+        for (int i = 0; i < game->table_count; i++) {
+            for (int j = 0; j < MAX_PLAYERS; j++) {
+                sem_post(&game->tables[i].turn_sem[j]);
+            }
         }
-        sem_post(&game->turn_done);
         sem_post(&game->log_items);
+        sem_post(&game->score_dirty);
     }
 }
 
-int main(void) {
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-e] [-p players] [-t tables] [-r pause_ms] [-f sync] [-q slots] [-s scores]"
+            " [-b board] [-S seed] [-m socket] [-T ms] [-K n] [-w shards]\n", prog);
+    fprintf(stderr, "  -e          epoll mode: one thread serves every socket (no fork)\n");
+    fprintf(stderr, "  -w shards   sharded epoll mode: this many event threads, one per CPU, each with\n"
+                    "              its own SO_REUSEPORT listener and its share of the tables\n");
+    fprintf(stderr, "  -p players  players per table (%d-%d); asked on stdin if omitted\n",
+            MIN_PLAYERS, MAX_PLAYERS);
+    fprintf(stderr, "  -t tables   number of concurrent tables (default %d)\n", DEFAULT_TABLES);
+    fprintf(stderr, "  -r ms       pause between rounds in milliseconds (default %d)\n",
+            DEFAULT_ROUND_PAUSE_MS);
+    fprintf(stderr, "  -f sync     game.log sync policy: never (default), batch, or an interval in ms\n");
+    fprintf(stderr, "  -q slots    log ring size, rounded up to a power of two (default %d)\n",
+            DEFAULT_LOG_SLOTS);
+    fprintf(stderr, "  -s scores   initial scoreboard capacity in players (default %d; doubles when full, up to %d)\n",
+            DEFAULT_SCORE_CAP, SCORE_MAX_CAP);
+    fprintf(stderr, "  -b file     load the board (size, snakes, ladders) from a file\n");
+    fprintf(stderr, "  -S seed     fixed dice seed, so the same joins and turns replay the same rolls\n");
+    fprintf(stderr, "  -m socket   metrics (Prometheus text) on this unix socket (default %s, - for none)\n",
+            DEFAULT_METRICS_SOCKET);
+    fprintf(stderr, "  -T ms       turn deadline; the server rolls for late players (default %d, 0 for none)\n",
+            DEFAULT_TURN_TIMEOUT_MS);
+    fprintf(stderr, "  -K n        drop a player after n timeouts in a row (default %d, 0 for never)\n",
+            DEFAULT_TURN_STRIKES);
+}
+
+int main(int argc, char **argv) {
     signal(SIGCHLD, reap);
     signal(SIGINT, handle_sigint);
 
     int target_players = 0;
-    /* Ask for number of players before starting the server. */
-    printf("Enter number of players (%d-%d): ", MIN_PLAYERS, MAX_PLAYERS);
-    fflush(stdout);
-    if (scanf("%d", &target_players) != 1) {
-        printf("Invalid input.\n");
+    int table_count = DEFAULT_TABLES;
+    int log_slots_wanted = DEFAULT_LOG_SLOTS;
+    int score_cap = DEFAULT_SCORE_CAP;
+    const char *board_file = NULL;
+    int dice_fixed = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "ep:t:r:f:q:s:b:S:m:T:K:w:h")) != -1) {
+        switch (opt) {
+        case 'e':
+            event_mode = 1;
+            break;
+        case 'w':
+            event_mode = 1;
+            shard_count = atoi(optarg);
+            if (shard_count < 1) {
+                shard_count = 1;
+            }
+            break;
+        case 'p':
+            target_players = atoi(optarg);
+            break;
+        case 't':
+            table_count = atoi(optarg);
+            break;
+        case 'r':
+            round_pause_ms = atoi(optarg);
+            if (round_pause_ms < 0) {
+                round_pause_ms = 0;
+            }
+            break;
+        case 'b':
+            board_file = optarg;
+            break;
+        case 'S':
+            dice_seed_value = strtoull(optarg, NULL, 0);
+            dice_fixed = 1;
+            break;
+        case 'm':
+            metrics_path = strcmp(optarg, "-") == 0 ? NULL : optarg;
+            break;
+        case 'T':
+            turn_timeout_ms = atoi(optarg);
+            if (turn_timeout_ms < 0) {
+                turn_timeout_ms = 0;
+            }
+            break;
+        case 'K':
+            turn_strikes = atoi(optarg);
+            if (turn_strikes < 0) {
+                turn_strikes = 0;
+            }
+            break;
+        case 's':
+            score_cap = atoi(optarg);
+            if (score_cap < 1) {
+                score_cap = 1;
+            }
+            if (score_cap > SCORE_MAX_CAP) {
+                score_cap = SCORE_MAX_CAP;
+            }
+            break;
+        case 'q':
+            log_slots_wanted = atoi(optarg);
+            if (log_slots_wanted < 2) {
+                log_slots_wanted = 2;
+            }
+            break;
+        case 'f':
+            if (strcmp(optarg, "never") == 0) {
+                log_sync = LOG_SYNC_NEVER;
+            } else if (strcmp(optarg, "batch") == 0) {
+                log_sync = LOG_SYNC_BATCH;
+            } else if (atoi(optarg) > 0) {
+                log_sync = LOG_SYNC_INTERVAL;
+                log_sync_interval_ms = atoi(optarg);
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    started_ns = now_ns();
+    if (table_count < 1) {
+        printf("Need at least one table.\n");
         return 1;
     }
+    if (shard_count > table_count) {
+        shard_count = table_count;
+    }
+
+    /* Ask for number of players before starting the server. */
+    if (target_players == 0) {
+        printf("Enter number of players (%d-%d): ", MIN_PLAYERS, MAX_PLAYERS);
+        fflush(stdout);
+        if (scanf("%d", &target_players) != 1) {
+            printf("Invalid input.\n");
+            return 1;
+        }
+    }
     if (target_players < MIN_PLAYERS || target_players > MAX_PLAYERS) {
         printf("Players must be between %d and %d.\n", MIN_PLAYERS, MAX_PLAYERS);
         return 1;
     }
 
     /* Shared memory setup. */
+    /* Shared memory layout: header, tables, then the log ring (cache-line aligned). */
+    unsigned long log_slots = 1;
+    while (log_slots < (unsigned long)log_slots_wanted) {
+        log_slots <<= 1;
+    }
+    size_t ring_off = sizeof(SharedGame) + (size_t)table_count * sizeof(GameTable);
+    ring_off = (ring_off + 63) & ~(size_t)63;
+    game_size = ring_off + (size_t)log_slots * sizeof(LogSlot);
     int shm_fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
     if (shm_fd < 0) {
         perror("shm_open");
         return 1;
     }
-    if (ftruncate(shm_fd, sizeof(SharedGame)) != 0) {
+    if (ftruncate(shm_fd, (off_t)game_size) != 0) {
         perror("ftruncate");
         return 1;
     }
 
-    game = mmap(NULL, sizeof(SharedGame), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    game = mmap(NULL, game_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
     if (game == MAP_FAILED) {
         perror("mmap");
         return 1;
     }
+    close(shm_fd);
+
+    /* Board: built-in unless a file was given; its jump table is built once here. */
+    board_init_default(&board);
+    if (board_file) {
+#ifdef SNL_FIXED_BOARD
+        printf("This server was built with a fixed board; -b is not supported.\n");
+        return 1;
+#else
+        char err[256];
+        if (board_load(&board, board_file, err, sizeof(err)) != 0) {
+            printf("Bad board: %s\n", err);
+            return 1;
+        }
+#endif
+    }
+    board_fingerprint = board_id(&board);
+    printf("Board: %d squares, %d snakes/ladders (%d %s), %zu KB jump table, %.1f ns/move\n",
+           board_size(&board), board.jumps, board.chains,
+           board.follow ? "chains resolved" : "land on another jump",
+           (board_bytes(&board) + 1023) / 1024, board_move_ns(&board, 1000000));
 
     /* Clear the shared state and initialize defaults. */
-    memset(game, 0, sizeof(SharedGame));
+    memset(game, 0, game_size);
     game->target_players = target_players;
-    game->active_players = 0;
-    game->winner_id = -1;
-    game->round_no = 0;
+    game->table_count = table_count;
+    if (!dice_fixed) {
+        dice_seed_value = dice_entropy_seed();
+    }
+    for (int i = 0; i < table_count; i++) {
+        game->tables[i].winner_id = -1;
+        game->tables[i].board_show_every = 3;
+        dice_seed(&game->tables[i].dice, dice_seed_value, (uint64_t)i);
+    }
+    printf("Dice: xoshiro256**, one stream per table, seed %llu (%s)\n",
+           (unsigned long long)dice_seed_value, dice_fixed ? "fixed" : "random");
 
     /* Make mutexes process-shared so children can lock them. */
     pthread_mutexattr_t attr;
     pthread_mutexattr_init(&attr);
     pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
-    pthread_mutex_init(&game->state_mutex, &attr);
-    pthread_mutex_init(&game->log_mutex, &attr);
+    pthread_mutex_init(&game->score_mutex, &attr);
+    pthread_mutex_init(&game->sched_mutex, &attr);
+    for (int i = 0; i < table_count; i++) {
+        pthread_mutex_init(&game->tables[i].lock, &attr);
+    }
 
     /* Init semaphores (pshared=1). */
     sem_init(&game->log_items, 1, 0);
-    sem_init(&game->log_spaces, 1, LOG_QUEUE_SIZE);
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        sem_init(&game->turn_sem[i], 1, 0);
+    sem_init(&game->score_dirty, 1, 0);
+
+    /* Every slot starts free for the producer that will claim its index. */
+    game->log.slots = (LogSlot *)((char *)game + ring_off);
+    game->log.mask = log_slots - 1;
+    for (unsigned long i = 0; i < log_slots; i++) {
+        game->log.slots[i].seq = i;
+    }
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&game->sched_cond, &cattr);
+    game->ready_head = -1;
+    game->ready_tail = -1;
+    for (int i = 0; i < table_count; i++) {
+        for (int j = 0; j < MAX_PLAYERS; j++) {
+            sem_init(&game->tables[i].turn_sem[j], 1, 0);
+        }
+    }
+
+    /*
+     * The scoreboard gets its own segment, sized for score_cap players and
+     * doubled when it fills. Address space for SCORE_MAX_CAP is reserved up
+     * front (and inherited by every child), so growing maps more of the
+     * segment in place and the board never moves. A fresh segment is
+     * zero-filled and tmpfs only backs pages that are touched, so memory
+     * grows with the number of players who actually won.
+     */
+    shm_unlink(SCORE_SHM_NAME);
+    scores_fd = shm_open(SCORE_SHM_NAME, O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (scores_fd < 0 || ftruncate(scores_fd, (off_t)scoreboard_bytes(score_cap)) != 0) {
+        perror("scoreboard shm");
+        return 1;
+    }
+    scores_base = mmap(NULL, scoreboard_bytes(SCORE_MAX_CAP), PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (scores_base == MAP_FAILED || scores_map(scoreboard_bytes(score_cap)) != 0) {
+        perror("scoreboard mmap");
+        return 1;
+    }
+    scoreboard_attach(&scores, scores_base, score_cap, 1);
+    scores_cap = score_cap;
+
+    /* Pull scores from disk: the snapshot, then journal records newer than it. */
+    journal_seq = replay_score_journal(load_scores_file());
+    journal_fd = open(SCORE_JOURNAL, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (journal_fd < 0) {
+        perror(SCORE_JOURNAL);
+    }
+    /* Start from a fresh snapshot and an empty journal (drops any torn record). */
+    compact_scores();
+
+    /* games.rec: keep the whole records already there, cut off a torn one, append. */
+    rec_fd = open(REC_FILE, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (rec_fd >= 0) {
+        long long valid = rec_scan(rec_fd);
+        if (valid < 0) {
+            fprintf(stderr, "%s is not a game recording; not recording\n", REC_FILE);
+            close(rec_fd);
+            rec_fd = -1;
+        } else if (valid == 0) {
+            RecFileHeader fh = {REC_FILE_MAGIC, REC_VERSION};
+            if (ftruncate(rec_fd, 0) != 0 || write(rec_fd, &fh, sizeof(fh)) != (ssize_t)sizeof(fh)) {
+                perror(REC_FILE);
+            }
+        } else if (ftruncate(rec_fd, (off_t)valid) != 0) {
+            perror(REC_FILE);
+        }
+    } else {
+        perror(REC_FILE);
     }
-    sem_init(&game->turn_done, 1, 0);
 
-    FILE *score_fp = fopen(SCORE_FILE, "a");
-    if (score_fp) {
-        fclose(score_fp);
+    /* Per-table scheduler bookkeeping (parent process only). */
+    sched = calloc((size_t)table_count, sizeof(TableSched));
+    if (!sched) {
+        perror("calloc");
+        return 1;
+    }
+    for (int i = 0; i < table_count; i++) {
+        sched[i].last_turn = -1;
+        sched[i].turn_timer.id = i;
     }
-    /* Pull scores from disk. */
-    load_scores_file();
 
-    /* Start background threads (scheduler + logger). */
+    /* Start background threads (scheduler, logger, score writer); epoll mode schedules inline. */
     pthread_t sched_thread;
     pthread_t log_thread;
-    pthread_create(&sched_thread, NULL, scheduler_thread, NULL);
+    pthread_t score_thread;
+    if (!event_mode) {
+        pthread_create(&sched_thread, NULL, scheduler_thread, NULL);
+    }
     pthread_create(&log_thread, NULL, logger_thread, NULL);
+    pthread_create(&score_thread, NULL, score_writer_thread, NULL);
+    pthread_t metrics_tid;
+    if (metrics_path) {
+        metrics_fd = open_metrics_socket(metrics_path);
+        if (metrics_fd >= 0) {
+            pthread_create(&metrics_tid, NULL, metrics_thread, NULL);
+            printf("Metrics: unix socket %s\n", metrics_path);
+        } else {
+            perror(metrics_path);
+        }
+    }
 
     /* Create and bind the listening socket. */
     server_fd = socket(AF_INET, SOCK_STREAM, 0);
@@ -775,8 +4111,12 @@ int main(void) {
         return 1;
     }
 
-    int opt = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    int reuse = 1;
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (shard_count > 1) {
+        /* The first shard's listener; the other shards bind their own next to it. */
+        setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+    }
 
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
@@ -788,67 +4128,81 @@ int main(void) {
         perror("bind");
         return 1;
     }
-    if (listen(server_fd, MAX_PLAYERS) != 0) {
+    if (listen(server_fd, SOMAXCONN) != 0) {
         perror("listen");
         return 1;
     }
 
-    printf("Snakes & Ladders Server running on port %d\n", PORT);
-    enqueue_log("Server started on port %d", PORT);
+    printf("Snakes & Ladders Server running on port %d (%d tables, %d players each, %s mode)\n",
+           PORT, table_count, target_players, event_mode ? "epoll" : "fork");
+    fflush(stdout);
+    if (event_mode && setup_shards() != 0) {
+        return 1;
+    }
+    GameEvent start_ev;
+    memset(&start_ev, 0, sizeof(start_ev));
+    start_ev.type = EV_SERVER_START;
+    start_ev.from = PORT;
+    log_push(&start_ev);
 
-    /* Accept exactly target_players clients, forking a child per client. */
-    for (int i = 0; i < target_players; i++) {
-        int client_fd = accept(server_fd, NULL, NULL);
-        if (client_fd < 0) {
-            perror("accept");
-            i--;
-            continue;
-        }
+    /* Either way, once the loop returns the server is shutting down. */
+    if (event_mode) {
+        run_shards();
+    } else {
+        run_fork_server();
+    }
 
-        pthread_mutex_lock(&game->state_mutex);
-        game->connected[i] = 1;
-        game->active_players++;
-        pthread_mutex_unlock(&game->state_mutex);
+    /* The scheduler sleeps on a condition variable; wake it up to exit. */
+    pthread_mutex_lock(&game->sched_mutex);
+    pthread_cond_broadcast(&game->sched_cond);
+    pthread_mutex_unlock(&game->sched_mutex);
 
-        pid_t pid = fork();
-        if (pid < 0) {
-            perror("fork");
-            pthread_mutex_lock(&game->state_mutex);
-            game->connected[i] = 0;
-            game->active_players--;
-            pthread_mutex_unlock(&game->state_mutex);
-            close(client_fd);
-            i--;
+    /*
+     * Record rounds cut short by the shutdown. trylock: a child killed mid-turn
+     * may have died holding its table lock.
+     */
+    for (int i = 0; i < table_count; i++) {
+        GameTable *t = &game->tables[i];
+        if (pthread_mutex_trylock(&t->lock) != 0) {
             continue;
         }
-        if (pid == 0) {
-            close(server_fd);
-            handle_client(client_fd, i);
-            exit(0);
+        if (t->game_started && !t->game_over) {
+            rec_flush_locked(t, REC_UNFINISHED, -1);
         }
+        pthread_mutex_unlock(&t->lock);
+    }
+    if (rec_fd >= 0) {
+        close(rec_fd);
+    }
 
-        close(client_fd);
+    if (metrics_fd >= 0) {
+        pthread_join(metrics_tid, NULL);
+        close(metrics_fd);
+        unlink(metrics_path);
     }
 
-    /* Kick off the first round once everyone has joined. */
-    pthread_mutex_lock(&game->state_mutex);
-    reset_game_locked();
-    enqueue_log("New game started (round %d)", game->round_no);
-    pthread_mutex_unlock(&game->state_mutex);
+    /* Let the logger drain the queue and close game.log. */
+    sem_post(&game->log_items);
+    pthread_join(log_thread, NULL);
 
-    /* Main thread just sleeps until SIGINT. */
-    while (server_running) {
-        pause();
+    /* Stop the score writer, then journal and compact whatever is left. */
+    sem_post(&game->score_dirty);
+    pthread_join(score_thread, NULL);
+    append_score_journal();
+    compact_scores();
+    if (journal_fd >= 0) {
+        close(journal_fd);
     }
 
-    /* Save scores on shutdown. */
-    pthread_mutex_lock(&game->state_mutex);
-    save_scores_file();
-    pthread_mutex_unlock(&game->state_mutex);
+    print_run_stats();
 
     /* Cleanup shared memory. */
-    munmap(game, sizeof(SharedGame));
+    munmap(scores_base, scoreboard_bytes(SCORE_MAX_CAP));
+    close(scores_fd);
+    shm_unlink(SCORE_SHM_NAME);
+    munmap(game, game_size);
     shm_unlink(SHM_NAME);
+    board_free(&board);
 
     return 0;
 }
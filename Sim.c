@@ -0,0 +1,488 @@
+/*
+snl-sim: headless Monte Carlo runs of a board, for tuning layouts.
+
+Plays games with the server's move rules (board_move: exact roll to finish,
+one table lookup per move) and no sockets. Each thread owns its own Dice.h
+stream and advances SIM_LANES games in lockstep: every step rolls for the
+same seat in all lanes, so positions are read and written as contiguous
+arrays and the step has no branches. It does not vectorize: the board
+lookup is a gather and the hit counts a scatter. A lane whose game ends sits
+out the rest of the round and starts a new game at the next seat-0 step.
+
+Reports the distribution of game length, wins by seat and how often each
+snake and ladder is hit. With -x the same numbers come from the exact
+Markov-chain solution (Markov.h) instead of sampling.
+*/
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Board.h"
+#include "Dice.h"
+#include "Markov.h"
+
+#define SIM_LANES 64
+#define SIM_MAX_SEATS 8
+#define SIM_HIST_BINS 65536
+#define SIM_SHOW_JUMPS 32
+
+/* Exact mode: push the distribution until at most this fraction of games is unfinished. */
+#define SIM_EXACT_TAIL 1e-12
+#define SIM_EXACT_MAX_TURNS 50000000
+/*
+ * The distribution costs turns x live squares, roughly size^2: a minute at
+ * 100000 squares. Above this it is skipped unless asked for with -f.
+ */
+#define SIM_EXACT_DIST_SQUARES 10000
+
+/* Everything one thread collects; merged after the join. */
+typedef struct {
+    const Board *board;
+    int players;
+    long long quota;
+    uint64_t seed;
+    int stream;
+
+    long long games;
+    long long turns_total;
+    long long wins[SIM_MAX_SEATS];
+    long long *hist;            /* game length in turns, bucketed by hist_width */
+    long long overflow;         /* games longer than the histogram */
+    long long min_turns;
+    long long max_turns;
+    unsigned long long *hits;   /* landings per square (size + 1) */
+} SimWork;
+
+static int hist_width = 1;
+
+static void *sim_thread(void *arg) {
+    SimWork *w = arg;
+    const Board *b = w->board;
+    const int size = board_size(b);
+    const int players = w->players;
+
+    DiceRng rng;
+    dice_seed(&rng, w->seed, (uint64_t)w->stream);
+
+    int pos[SIM_MAX_SEATS][SIM_LANES];
+    long long turns[SIM_LANES];
+    int active[SIM_LANES];
+    uint8_t rolls[SIM_LANES];
+    int done[SIM_LANES];
+    memset(active, 0, sizeof(active));
+    long long started = 0;
+    w->min_turns = -1;
+
+    for (;;) {
+        /* Round boundary: refill idle lanes with new games. */
+        int live = 0;
+        for (int l = 0; l < SIM_LANES; l++) {
+            if (!active[l] && started < w->quota) {
+                for (int s = 0; s < players; s++) {
+                    pos[s][l] = 0;
+                }
+                turns[l] = 0;
+                active[l] = 1;
+                started++;
+            }
+            live += active[l];
+        }
+        if (live == 0) {
+            break;
+        }
+
+        for (int s = 0; s < players; s++) {
+            dice_fill(&rng, rolls, SIM_LANES);
+
+            /* The lockstep step: same seat in every lane, branch-free. */
+            int *p = pos[s];
+            int any_done = 0;
+            for (int l = 0; l < SIM_LANES; l++) {
+                int cur = p[l];
+                int landed = 0;
+                int next = board_move(b, cur, rolls[l], &landed);
+                int on = active[l];
+                p[l] = on ? next : cur;
+                turns[l] += on;
+                w->hits[landed] += (unsigned long long)(on & (landed != cur));
+                done[l] = on & (next == size);
+                any_done |= done[l];
+            }
+            if (!any_done) {
+                continue;
+            }
+
+            for (int l = 0; l < SIM_LANES; l++) {
+                if (!done[l]) {
+                    continue;
+                }
+                long long t = turns[l];
+                active[l] = 0;
+                w->games++;
+                w->wins[s]++;
+                w->turns_total += t;
+                if (w->min_turns < 0 || t < w->min_turns) {
+                    w->min_turns = t;
+                }
+                if (t > w->max_turns) {
+                    w->max_turns = t;
+                }
+                long long bin = t / hist_width;
+                if (bin < SIM_HIST_BINS) {
+                    w->hist[bin]++;
+                } else {
+                    w->overflow++;
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Smallest length (in turns) with at least frac of games at or below it. */
+static long long hist_percentile(const long long *hist, long long games, double frac) {
+    long long want = (long long)(frac * (double)games);
+    long long seen = 0;
+    for (int i = 0; i < SIM_HIST_BINS; i++) {
+        seen += hist[i];
+        if (seen > want) {
+            return (long long)i * hist_width;
+        }
+    }
+    return (long long)SIM_HIST_BINS * hist_width;
+}
+
+typedef struct {
+    int from;
+    int to;
+    unsigned long long hits;
+} JumpHits;
+
+static int by_hits(const void *a, const void *b) {
+    const JumpHits *x = a;
+    const JumpHits *y = b;
+    if (x->hits != y->hits) {
+        return x->hits > y->hits ? -1 : 1;
+    }
+    return x->from - y->from;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Smallest game length (in turns) with more than frac of the probability at or below it. */
+static long long dist_percentile(const double *dist, size_t len, double frac) {
+    double seen = 0.0;
+    for (size_t i = 0; i < len; i++) {
+        seen += dist[i];
+        if (seen > frac) {
+            return (long long)i;
+        }
+    }
+    return (long long)len;
+}
+
+/* -x: solve the board exactly instead of playing it. */
+static int exact_report(const Board *b, int players, int dump, int force_dist) {
+    int size = board_size(b);
+    double start = now_s();
+
+    double *expected = malloc(((size_t)size + 1) * sizeof(double));
+    if (!expected) {
+        perror("malloc");
+        return 1;
+    }
+    MarkovStats st;
+    char err[256];
+    if (markov_expected_turns(b, expected, &st, err, sizeof(err)) != 0) {
+        fprintf(stderr, "Cannot solve the board: %s\n", err);
+        free(expected);
+        return 1;
+    }
+
+    if (size > SIM_EXACT_DIST_SQUARES && !force_dist) {
+        printf("snl-sim -x: exact solution, %d-square board (%d snakes/ladders)\n", size, b->jumps);
+        printf("Time: %.3f s (LU %.3f ms over a %zu-entry envelope, solve %.3f ms)\n",
+               now_s() - start, st.factor_ms, st.envelope, st.solve_ms);
+        printf("One player alone: expected %.4f turns to finish\n", expected[0]);
+        printf("(game length and win by seat skipped on boards over %d squares; -f computes them)\n",
+               SIM_EXACT_DIST_SQUARES);
+        free(expected);
+        return 0;
+    }
+
+    double dist_start = now_s();
+    int turns = 0;
+    double tail = 0.0;
+    /* A game is still running only while every seat is: stop once tail^players is negligible. */
+    double *f = markov_finish_dist(b, pow(SIM_EXACT_TAIL, 1.0 / players), SIM_EXACT_MAX_TURNS, &turns, &tail);
+    size_t len = (size_t)turns * (size_t)players + 1;
+    double *game_len = f ? malloc(len * sizeof(double)) : NULL;
+    if (!game_len) {
+        perror("malloc");
+        free(expected);
+        free(f);
+        return 1;
+    }
+    double win[SIM_MAX_SEATS];
+    markov_seats(f, turns, players, win, game_len);
+    double elapsed = now_s() - start;
+
+    double mean = 0.0;
+    double mass = 0.0;
+    for (size_t i = 0; i < len; i++) {
+        mean += (double)i * game_len[i];
+        mass += game_len[i];
+    }
+    mean /= mass;
+    /* Shortest game: seat 1 takes the fastest route. */
+    long long min_len = (long long)(markov_min_turns(b) - 1) * players + 1;
+
+    printf("snl-sim -x: exact solution, %d players, %d-square board (%d snakes/ladders)\n",
+           players, size, b->jumps);
+    printf("Time: %.3f s (LU %.3f ms over a %zu-entry envelope, solve %.3f ms, distribution %.3f s to turn %d)\n",
+           elapsed, st.factor_ms, st.envelope, st.solve_ms, now_s() - dist_start, turns - 1);
+    printf("One player alone: expected %.4f turns to finish\n", expected[0]);
+    printf("Game length in turns (all seats): mean %.4f, min %lld, median %lld, p90 %lld, p99 %lld\n",
+           mean, min_len, dist_percentile(game_len, len, 0.5), dist_percentile(game_len, len, 0.9),
+           dist_percentile(game_len, len, 0.99));
+    printf("Game length in rounds: mean %.4f\n", mean / players);
+    printf("Win by seat:");
+    for (int s = 0; s < players; s++) {
+        printf(" %d: %.3f%%", s + 1, 100.0 * win[s]);
+    }
+    printf("\n");
+    if (tail > 0.0) {
+        printf("(stopped after %d turns per player with %.3g of the games unfinished)\n", turns - 1,
+               pow(tail, players));
+    }
+
+    if (dump) {
+        printf("Distribution (turns probability):\n");
+        for (size_t i = 0; i < len; i++) {
+            if (game_len[i] > 0.0) {
+                printf("%zu %.6e\n", i, game_len[i]);
+            }
+        }
+    }
+
+    free(expected);
+    free(f);
+    free(game_len);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-b board] [-p players] [-n games] [-j threads] [-s seed] [-d] [-x [-f]]\n", prog);
+    fprintf(stderr, "  -b board    board file (default: the built-in board)\n");
+    fprintf(stderr, "  -p players  players per game, 1-%d (default 4)\n", SIM_MAX_SEATS);
+    fprintf(stderr, "  -n games    games to play (default 10000000)\n");
+    fprintf(stderr, "  -j threads  worker threads (default: every online CPU)\n");
+    fprintf(stderr, "  -s seed     dice seed (default: random)\n");
+    fprintf(stderr, "  -d          also print the full game length distribution\n");
+    fprintf(stderr, "  -x          solve the board exactly (Markov chain) instead of simulating;\n");
+    fprintf(stderr, "              on boards over %d squares only the expected turns\n", SIM_EXACT_DIST_SQUARES);
+    fprintf(stderr, "  -f          with -x, also compute game length and win by seat on any board\n");
+    fprintf(stderr, "              (slow: about size^2 work, a minute at 100000 squares)\n");
+}
+
+int main(int argc, char **argv) {
+    const char *board_file = NULL;
+    int players = 4;
+    long long games = 10000000;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t seed = dice_entropy_seed();
+    int dump = 0;
+    int exact = 0;
+    int force_dist = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:p:n:j:s:dxfh")) != -1) {
+        switch (opt) {
+        case 'b':
+            board_file = optarg;
+            break;
+        case 'p':
+            players = atoi(optarg);
+            break;
+        case 'n':
+            games = atoll(optarg);
+            break;
+        case 'j':
+            threads = atol(optarg);
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'd':
+            dump = 1;
+            break;
+        case 'x':
+            exact = 1;
+            break;
+        case 'f':
+            force_dist = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (players < 1 || players > SIM_MAX_SEATS || games < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    Board board;
+    board_init_default(&board);
+    if (board_file) {
+        char err[256];
+        if (board_load(&board, board_file, err, sizeof(err)) != 0) {
+            fprintf(stderr, "Bad board: %s\n", err);
+            return 1;
+        }
+    }
+    if (exact) {
+        int rc = exact_report(&board, players, dump, force_dist);
+        board_free(&board);
+        return rc;
+    }
+    int size = board_size(&board);
+    hist_width = 1 + (int)((long long)size * players / (SIM_HIST_BINS / 8));
+
+    SimWork *work = calloc((size_t)threads, sizeof(SimWork));
+    pthread_t *tids = calloc((size_t)threads, sizeof(pthread_t));
+    if (!work || !tids) {
+        perror("calloc");
+        return 1;
+    }
+    for (long i = 0; i < threads; i++) {
+        SimWork *w = &work[i];
+        w->board = &board;
+        w->players = players;
+        w->quota = games / threads + (i < games % threads ? 1 : 0);
+        w->seed = seed;
+        w->stream = (int)i;
+        w->hist = calloc(SIM_HIST_BINS, sizeof(long long));
+        w->hits = calloc((size_t)size + 1, sizeof(unsigned long long));
+        if (!w->hist || !w->hits) {
+            perror("calloc");
+            return 1;
+        }
+    }
+
+    double start = now_s();
+    for (long i = 0; i < threads; i++) {
+        int rc = pthread_create(&tids[i], NULL, sim_thread, &work[i]);
+        if (rc != 0) {
+            errno = rc;
+            perror("pthread_create");
+            return 1;
+        }
+    }
+    for (long i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    double elapsed = now_s() - start;
+
+    /* Merge into thread 0. */
+    SimWork *all = &work[0];
+    for (long i = 1; i < threads; i++) {
+        SimWork *w = &work[i];
+        all->games += w->games;
+        all->turns_total += w->turns_total;
+        all->overflow += w->overflow;
+        for (int s = 0; s < players; s++) {
+            all->wins[s] += w->wins[s];
+        }
+        for (int j = 0; j < SIM_HIST_BINS; j++) {
+            all->hist[j] += w->hist[j];
+        }
+        for (int j = 0; j <= size; j++) {
+            all->hits[j] += w->hits[j];
+        }
+        if (w->min_turns >= 0 && (all->min_turns < 0 || w->min_turns < all->min_turns)) {
+            all->min_turns = w->min_turns;
+        }
+        if (w->max_turns > all->max_turns) {
+            all->max_turns = w->max_turns;
+        }
+    }
+
+    double n = (double)all->games;
+    double mean = all->turns_total / n;
+    printf("snl-sim: %lld games, %d players, %d-square board (%d snakes/ladders), %ld threads, seed %llu\n",
+           all->games, players, size, board.jumps, threads, (unsigned long long)seed);
+    printf("Time: %.2f s (%.2f M games/s, %.1f M turns/s)\n", elapsed,
+           n / elapsed / 1e6, (double)all->turns_total / elapsed / 1e6);
+    printf("Game length in turns (all seats): mean %.2f, min %lld, median %lld, p90 %lld, p99 %lld, max %lld\n",
+           mean, all->min_turns, hist_percentile(all->hist, all->games, 0.5),
+           hist_percentile(all->hist, all->games, 0.9), hist_percentile(all->hist, all->games, 0.99),
+           all->max_turns);
+    printf("Game length in rounds: mean %.2f\n", mean / players);
+    if (hist_width > 1) {
+        printf("(percentiles are rounded down to multiples of %d turns)\n", hist_width);
+    }
+
+    printf("Win by seat:");
+    for (int s = 0; s < players; s++) {
+        printf(" %d: %.3f%%", s + 1, 100.0 * (double)all->wins[s] / n);
+    }
+    printf("\n");
+
+    /* Jumps, most hit first. */
+    JumpHits *jumps = malloc((size_t)(board.jumps > 0 ? board.jumps : 1) * sizeof(JumpHits));
+    int njumps = 0;
+    for (int i = 1; i <= size && jumps; i++) {
+        if (board.dest[i] != i && njumps < board.jumps) {
+            jumps[njumps].from = i;
+            jumps[njumps].to = board.dest[i];
+            jumps[njumps].hits = all->hits[i];
+            njumps++;
+        }
+    }
+    if (jumps) {
+        qsort(jumps, (size_t)njumps, sizeof(JumpHits), by_hits);
+        int shown = njumps < SIM_SHOW_JUMPS ? njumps : SIM_SHOW_JUMPS;
+        printf("Snakes and ladders hit (%d of %d shown, most hit first):\n", shown, njumps);
+        for (int i = 0; i < shown; i++) {
+            printf("  %-6s %d -> %d: %.4f per game (%llu)\n",
+                   jumps[i].to < jumps[i].from ? "snake" : "ladder", jumps[i].from, jumps[i].to,
+                   (double)jumps[i].hits / n, jumps[i].hits);
+        }
+        free(jumps);
+    }
+
+    if (dump) {
+        printf("Distribution (turns games):\n");
+        for (int i = 0; i < SIM_HIST_BINS; i++) {
+            if (all->hist[i] > 0) {
+                printf("%lld %lld\n", (long long)i * hist_width, all->hist[i]);
+            }
+        }
+        if (all->overflow > 0) {
+            printf(">=%lld %lld\n", (long long)SIM_HIST_BINS * hist_width, all->overflow);
+        }
+    }
+
+    for (long i = 0; i < threads; i++) {
+        free(work[i].hist);
+        free(work[i].hits);
+    }
+    free(work);
+    free(tids);
+    board_free(&board);
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+TimerWheel: hashed timing wheel (see TimerWheel.h).
+*/
+
+#include "TimerWheel.h"
+
+#include <stdlib.h>
+
+int wheel_init(TimerWheel *w, unsigned slots, long long tick_ms, long long now_ms) {
+    unsigned n = 1;
+    while (n < slots) {
+        n <<= 1;
+    }
+    w->slots = calloc(n, sizeof(WheelTimer *));
+    if (!w->slots) {
+        return -1;
+    }
+    w->mask = n - 1;
+    w->tick_ms = tick_ms > 0 ? tick_ms : 1;
+    w->tick = now_ms / w->tick_ms;
+    w->armed = 0;
+    return 0;
+}
+
+void wheel_free(TimerWheel *w) {
+    free(w->slots);
+    w->slots = NULL;
+}
+
+static void wheel_unlink(TimerWheel *w, WheelTimer *t) {
+    if (t->prev) {
+        t->prev->next = t->next;
+    } else {
+        w->slots[t->due_tick & w->mask] = t->next;
+    }
+    if (t->next) {
+        t->next->prev = t->prev;
+    }
+    t->prev = NULL;
+    t->next = NULL;
+    t->armed = 0;
+    w->armed--;
+}
+
+void wheel_arm(TimerWheel *w, WheelTimer *t, long long due_ms) {
+    if (t->armed) {
+        wheel_unlink(w, t);
+    }
+    long long due_tick = (due_ms + w->tick_ms - 1) / w->tick_ms;
+    if (due_tick <= w->tick) {
+        due_tick = w->tick + 1;
+    }
+    WheelTimer **head = &w->slots[due_tick & w->mask];
+    t->due_tick = due_tick;
+    t->prev = NULL;
+    t->next = *head;
+    if (*head) {
+        (*head)->prev = t;
+    }
+    *head = t;
+    t->armed = 1;
+    w->armed++;
+}
+
+void wheel_cancel(TimerWheel *w, WheelTimer *t) {
+    if (t->armed) {
+        wheel_unlink(w, t);
+    }
+}
+
+WheelTimer *wheel_expire(TimerWheel *w, long long now_ms) {
+    long long now_tick = now_ms / w->tick_ms;
+    if (w->armed == 0) {
+        if (now_tick > w->tick) {
+            w->tick = now_tick;
+        }
+        return NULL;
+    }
+    while (w->tick < now_tick) {
+        long long next = w->tick + 1;
+        for (WheelTimer *t = w->slots[next & w->mask]; t; t = t->next) {
+            if (t->due_tick <= next) {
+                wheel_unlink(w, t);
+                return t;
+            }
+        }
+        w->tick = next;
+    }
+    return NULL;
+}
+
+long long wheel_next_due(const TimerWheel *w) {
+    if (w->armed == 0) {
+        return -1;
+    }
+    for (long long k = 1; k <= (long long)w->mask + 1; k++) {
+        long long tick = w->tick + k;
+        for (const WheelTimer *t = w->slots[tick & w->mask]; t; t = t->next) {
+            if (t->due_tick <= tick) {
+                return tick * w->tick_ms;
+            }
+        }
+    }
+    /* Everything armed is more than one turn of the wheel away: look again then. */
+    return (w->tick + (long long)w->mask + 1) * w->tick_ms;
+}
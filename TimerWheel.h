@@ -0,0 +1,47 @@
+/*
+TimerWheel: a hashed timing wheel for per-table turn deadlines.
+
+Every turn arms a deadline and almost every turn cancels it again (the
+player rolls in time), so arming and cancelling must be O(1): a timer is an
+intrusive node on a doubly linked list in the slot for its tick, and the
+wheel is advanced one tick at a time by whoever owns it. Deadlines further
+out than one turn of the wheel stay in their slot and are skipped until
+their own pass comes round.
+
+A wheel and its timers are private to one thread; there is no locking.
+*/
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+typedef struct WheelTimer {
+    struct WheelTimer *prev;
+    struct WheelTimer *next;
+    long long due_tick;
+    int armed;
+    int id;                 /* owner's tag (the table) */
+} WheelTimer;
+
+typedef struct {
+    WheelTimer **slots;
+    unsigned mask;          /* slot count - 1 (power of two) */
+    long long tick_ms;
+    long long tick;         /* every tick up to and including this one has been expired */
+    int armed;
+} TimerWheel;
+
+/* slots is rounded up to a power of two. 0, or -1 if out of memory. */
+int wheel_init(TimerWheel *w, unsigned slots, long long tick_ms, long long now_ms);
+void wheel_free(TimerWheel *w);
+
+/* (Re)arm t to fire at due_ms, rounded up to the next tick. */
+void wheel_arm(TimerWheel *w, WheelTimer *t, long long due_ms);
+void wheel_cancel(TimerWheel *w, WheelTimer *t);
+
+/* Next timer that is due by now_ms (already disarmed), or NULL. */
+WheelTimer *wheel_expire(TimerWheel *w, long long now_ms);
+
+/* When the next armed timer is due (to the tick), or -1 if none is armed. */
+long long wheel_next_due(const TimerWheel *w);
+
+#endif
@@ -0,0 +1,225 @@
+/*
+Wire: binary client protocol encoding and decoding (see Wire.h).
+*/
+
+#include "Wire.h"
+
+#include <string.h>
+
+size_t wire_begin(OutBuf *ob, int type) {
+    size_t at = ob->len;
+    unsigned char hdr[WIRE_HEADER] = {0, 0, (unsigned char)type};
+    outbuf_write(ob, (const char *)hdr, sizeof(hdr));
+    return at;
+}
+
+void wire_u8(OutBuf *ob, unsigned v) {
+    char b = (char)(unsigned char)v;
+    outbuf_write(ob, &b, 1);
+}
+
+void wire_u32(OutBuf *ob, uint32_t v) {
+    unsigned char b[4] = {(unsigned char)(v >> 24), (unsigned char)(v >> 16),
+                          (unsigned char)(v >> 8), (unsigned char)v};
+    outbuf_write(ob, (const char *)b, sizeof(b));
+}
+
+void wire_name(OutBuf *ob, const char *name) {
+    size_t len = strnlen(name, WIRE_NAME_MAX);
+    wire_u8(ob, (unsigned)len);
+    outbuf_write(ob, name, len);
+}
+
+void wire_end(OutBuf *ob, size_t at) {
+    if (ob->failed || ob->len < at + WIRE_HEADER) {
+        return;
+    }
+    size_t len = ob->len - at - WIRE_HEADER;
+    ob->data[at] = (char)(unsigned char)(len >> 8);
+    ob->data[at + 1] = (char)(unsigned char)len;
+}
+
+void wire_empty(OutBuf *ob, int type) {
+    wire_end(ob, wire_begin(ob, type));
+}
+
+void wire_text(OutBuf *ob, int type, const char *text) {
+    size_t at = wire_begin(ob, type);
+    size_t len = strlen(text);
+    if (len > WIRE_MAX_PAYLOAD) {
+        len = WIRE_MAX_PAYLOAD;
+    }
+    outbuf_write(ob, text, len);
+    wire_end(ob, at);
+}
+
+void wire_roll_result(OutBuf *ob, int seat, const TurnResult *r) {
+    size_t at = wire_begin(ob, WIRE_ROLL_RESULT);
+    wire_u8(ob, (unsigned)seat);
+    wire_u8(ob, (unsigned)r->dice);
+    wire_u32(ob, (uint32_t)r->before);
+    wire_u32(ob, (uint32_t)r->after);
+    wire_u8(ob, (r->won ? WIRE_WON : 0) | (r->moved ? 0 : WIRE_STAYED));
+    wire_end(ob, at);
+    if (r->jump_from != 0) {
+        at = wire_begin(ob, WIRE_JUMP);
+        wire_u8(ob, (unsigned)seat);
+        wire_u32(ob, (uint32_t)r->jump_from);
+        wire_u32(ob, (uint32_t)r->jump_to);
+        wire_end(ob, at);
+    }
+}
+
+int wire_pop(LineBuf *lb, uint8_t *frame) {
+    if (lb->len < WIRE_HEADER) {
+        return WIRE_NOT_YET;
+    }
+    const unsigned char *p = (const unsigned char *)lb->data + lb->head;
+    size_t payload = (size_t)p[0] << 8 | p[1];
+    if (payload > WIRE_MAX_PAYLOAD) {
+        return WIRE_TOO_BIG;
+    }
+    size_t total = WIRE_HEADER + payload;
+    if (lb->len < total) {
+        return WIRE_NOT_YET;
+    }
+    memcpy(frame, p, total);
+    lb->head += total;
+    lb->len -= total;
+    if (lb->len == 0) {
+        lb->head = 0;
+    }
+    return (int)total;
+}
+
+int wire_read(LineBuf *lb, uint8_t *frame) {
+    for (;;) {
+        int n = wire_pop(lb, frame);
+        if (n >= 0) {
+            return n;
+        }
+        if (n == WIRE_TOO_BIG || linebuf_fill(lb) <= 0) {
+            return -1;
+        }
+    }
+}
+
+/* Bounds-checked payload reader. */
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    int bad;
+} WireCursor;
+
+static unsigned get8(WireCursor *c) {
+    if (c->end - c->p < 1) {
+        c->bad = 1;
+        return 0;
+    }
+    return *c->p++;
+}
+
+static uint32_t get32(WireCursor *c) {
+    if (c->end - c->p < 4) {
+        c->bad = 1;
+        c->p = c->end;
+        return 0;
+    }
+    uint32_t v = (uint32_t)c->p[0] << 24 | (uint32_t)c->p[1] << 16 | (uint32_t)c->p[2] << 8 | c->p[3];
+    c->p += 4;
+    return v;
+}
+
+static const char *get_name(WireCursor *c, uint8_t *len) {
+    *len = (uint8_t)get8(c);
+    if (c->end - c->p < *len) {
+        c->bad = 1;
+        c->p = c->end;
+        return NULL;
+    }
+    const char *name = (const char *)c->p;
+    c->p += *len;
+    return name;
+}
+
+int wire_decode(const uint8_t *frame, size_t len, WireMsg *m) {
+    if (len < WIRE_HEADER || len != WIRE_HEADER + ((size_t)frame[0] << 8 | frame[1])) {
+        return -1;
+    }
+    WireCursor c = {frame + WIRE_HEADER, frame + len, 0};
+    m->type = frame[2];
+    m->count = 0;
+
+    switch (m->type) {
+    case WIRE_ROLL:
+    case WIRE_RESYNC:
+        break;
+    case WIRE_JOIN:
+    case WIRE_TEXT:
+        m->text = (const char *)c.p;
+        m->text_len = (size_t)(c.end - c.p);
+        c.p = c.end;
+        break;
+    case WIRE_WELCOME:
+        m->seat = (uint8_t)get8(&c);
+        m->a = get32(&c);
+        m->u8a = (uint8_t)get8(&c);
+        m->u8b = (uint8_t)get8(&c);
+        m->b = get32(&c);
+        m->c = get8(&c);
+        break;
+    case WIRE_ROUND_START:
+        m->a = get32(&c);
+        m->b = get32(&c);
+        break;
+    case WIRE_TURN_START:
+        m->u8a = (uint8_t)get8(&c);
+        break;
+    case WIRE_ROLL_RESULT:
+        m->seat = (uint8_t)get8(&c);
+        m->u8a = (uint8_t)get8(&c);
+        m->a = get32(&c);
+        m->b = get32(&c);
+        m->u8b = (uint8_t)get8(&c);
+        break;
+    case WIRE_JUMP:
+        m->seat = (uint8_t)get8(&c);
+        m->a = get32(&c);
+        m->b = get32(&c);
+        break;
+    case WIRE_POSITIONS:
+    case WIRE_PLAYERS:
+        while (c.p < c.end && !c.bad && m->count < WIRE_MAX_ENTRIES) {
+            WireEntry *e = &m->entries[m->count++];
+            e->seat = (uint8_t)get8(&c);
+            e->value = get32(&c);
+            e->name = NULL;
+            e->name_len = 0;
+            if (m->type == WIRE_PLAYERS) {
+                e->name = get_name(&c, &e->name_len);
+            }
+        }
+        break;
+    case WIRE_GAME_OVER: {
+        uint8_t name_len = 0;
+        m->seat = (uint8_t)get8(&c);
+        m->text = get_name(&c, &name_len);
+        m->text_len = name_len;
+        break;
+    }
+    case WIRE_SCOREBOARD:
+        m->a = get32(&c);
+        m->b = get32(&c);
+        m->c = get32(&c);
+        while (c.p < c.end && !c.bad && m->count < WIRE_MAX_ENTRIES) {
+            WireEntry *e = &m->entries[m->count++];
+            e->seat = WIRE_NO_SEAT;
+            e->value = get32(&c);
+            e->name = get_name(&c, &e->name_len);
+        }
+        break;
+    default:
+        return -1;
+    }
+    return c.bad || c.p != c.end ? -1 : 0;
+}
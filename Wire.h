@@ -0,0 +1,130 @@
+/*
+Wire: the binary client protocol, shared by the server, the client and
+snl-wirebench.
+
+A client that sends the line "@binary" before anything else switches both
+directions from text lines to frames:
+
+    uint16 length   payload bytes (big-endian, at most WIRE_MAX_PAYLOAD)
+    uint8  type     WireType
+    payload         fields below, integers big-endian, names as uint8
+                    length + bytes
+
+Telnet users never send "@binary" and keep the text protocol.
+
+Client to server:
+    WIRE_JOIN         name
+    WIRE_ROLL         (empty) roll the dice, answers WIRE_TURN_START
+    WIRE_RESYNC       (empty) send WIRE_PLAYERS again
+
+Server to client:
+    WIRE_WELCOME      u8 seat, u32 table, u8 players, u8 target,
+                      u32 board size, u8 board cols
+    WIRE_ROUND_START  u32 table, u32 round
+    WIRE_TURN_START   u8 flags (WIRE_SHOW_BOARD): your turn, send WIRE_ROLL
+    WIRE_ROLL_RESULT  u8 seat, u8 dice, u32 before, u32 after, u8 flags
+    WIRE_JUMP         u8 seat, u32 from, u32 to (follows its roll)
+    WIRE_POSITIONS    n x (u8 seat, u32 pos): positions that changed
+    WIRE_PLAYERS      n x (u8 seat, u32 pos, name): every seated player
+    WIRE_GAME_OVER    u8 winner seat (WIRE_NO_SEAT: none), name
+    WIRE_SCOREBOARD   u32 players, u32 my rank, u32 my wins,
+                      n x (u32 wins, name), best first
+    WIRE_TEXT         text lines, for anything without a type of its own
+*/
+
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Board.h"
+#include "NetBuf.h"
+
+#define WIRE_HEADER 3
+#define WIRE_MAX_PAYLOAD (LINEBUF_SIZE - WIRE_HEADER)   /* a frame must fit the read buffer */
+#define WIRE_MAX_ENTRIES 16
+#define WIRE_NAME_MAX 255
+#define WIRE_NO_SEAT 0xff
+
+typedef enum {
+    WIRE_JOIN = 1,
+    WIRE_ROLL,
+    WIRE_RESYNC,
+
+    WIRE_WELCOME = 16,
+    WIRE_ROUND_START,
+    WIRE_TURN_START,
+    WIRE_ROLL_RESULT,
+    WIRE_JUMP,
+    WIRE_POSITIONS,
+    WIRE_PLAYERS,
+    WIRE_GAME_OVER,
+    WIRE_SCOREBOARD,
+    WIRE_TEXT
+} WireType;
+
+/* WIRE_TURN_START flags. */
+#define WIRE_SHOW_BOARD 0x01
+
+/* WIRE_ROLL_RESULT flags. */
+#define WIRE_WON 0x01
+#define WIRE_STAYED 0x02   /* exact roll needed, no move */
+
+/* One entry of WIRE_POSITIONS, WIRE_PLAYERS or WIRE_SCOREBOARD. */
+typedef struct {
+    uint8_t seat;
+    uint32_t value;        /* position, or wins */
+    const char *name;      /* not terminated; NULL in WIRE_POSITIONS */
+    uint8_t name_len;
+} WireEntry;
+
+/*
+ * A decoded frame. The meaning of the numbered fields follows the payload
+ * order in the table above; pointers point into the frame buffer.
+ */
+typedef struct {
+    uint8_t type;
+    uint8_t seat;
+    uint8_t u8a;           /* dice, players, flags (TURN_START) */
+    uint8_t u8b;           /* target, flags (ROLL_RESULT) */
+    uint32_t a;            /* first u32: table, before, from, players */
+    uint32_t b;            /* second u32: board size, round, after, to, rank */
+    uint32_t c;            /* board cols, my wins */
+    const char *text;      /* JOIN, GAME_OVER name, TEXT */
+    size_t text_len;
+    int count;
+    WireEntry entries[WIRE_MAX_ENTRIES];
+} WireMsg;
+
+/* Start a frame in ob; returns the offset to pass to wire_end. */
+size_t wire_begin(OutBuf *ob, int type);
+void wire_u8(OutBuf *ob, unsigned v);
+void wire_u32(OutBuf *ob, uint32_t v);
+void wire_name(OutBuf *ob, const char *name);
+/* Patch the frame's length in. */
+void wire_end(OutBuf *ob, size_t at);
+
+/* A frame with no payload, or text only. */
+void wire_empty(OutBuf *ob, int type);
+void wire_text(OutBuf *ob, int type, const char *text);
+
+void wire_roll_result(OutBuf *ob, int seat, const TurnResult *r);
+
+#define WIRE_NOT_YET (-1)   /* wire_pop: no complete frame buffered yet */
+#define WIRE_TOO_BIG (-2)   /* wire_pop: the header announces more than WIRE_MAX_PAYLOAD */
+
+/*
+ * Take the next complete frame out of lb into frame (at least LINEBUF_SIZE
+ * bytes): its total length, WIRE_NOT_YET if none is buffered yet, or
+ * WIRE_TOO_BIG if the next frame could never fit the buffer (drop the peer).
+ */
+int wire_pop(LineBuf *lb, uint8_t *frame);
+
+/* Blocking wire_pop: length, or -1 on EOF/error. */
+int wire_read(LineBuf *lb, uint8_t *frame);
+
+/* Decode a popped frame: 0, or -1 if it is malformed. */
+int wire_decode(const uint8_t *frame, size_t len, WireMsg *m);
+
+#endif
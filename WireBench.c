@@ -0,0 +1,214 @@
+/*
+snl-wirebench: cost of the text and binary client protocols, without sockets.
+
+Usage: snl-wirebench [-n moves] [-p players]
+
+Plays moves on the built-in board and encodes each one the way every seat
+of an epoll table receives it: the text protocol's roll lines plus the
+"Positions:" line, the same with an @D update instead (what ./client -L
+gets), and WIRE_ROLL_RESULT (+ WIRE_JUMP) + WIRE_POSITIONS. Then it parses
+the streams the way the client does: split lines and look for YOUR_TURN, or
+pop and decode frames. Prints bytes, format and parse time per move.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Board.h"
+#include "Dice.h"
+#include "NetBuf.h"
+#include "Wire.h"
+
+#define BENCH_PLAYERS_MAX 5
+
+typedef enum { FMT_TEXT, FMT_DELTA, FMT_BINARY, FMT_COUNT } Format;
+
+static const char *format_name[FMT_COUNT] = {"text", "delta", "binary"};
+
+static const char *names[BENCH_PLAYERS_MAX] = {"alice", "bob", "carol", "dave", "erin"};
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Same text as the server's out_turn_result. */
+static void text_move(OutBuf *out, int size, const char *name, const TurnResult *r, const char *positions) {
+    outbuf_printf(out, "Player %s rolled %d -> position %d\n", name, r->dice, r->after);
+    if (!r->moved) {
+        outbuf_printf(out, "Exact roll needed to reach %d. %s stays in place.\n", size, name);
+    }
+    if (r->jump_from != 0) {
+        outbuf_printf(out, "%s %d -> %d\n", r->jump_to < r->jump_from ? "Snake!" : "Ladder!",
+                      r->jump_from, r->jump_to);
+    }
+    if (positions[0]) {
+        outbuf_printf(out, "Positions: %s\n", positions);
+    }
+    if (r->won) {
+        outbuf_printf(out, "Player %s WON the game\n", name);
+    }
+}
+
+/* Same as the server's build_positions_locked. */
+static void positions_line(const int *pos, int players, char *out, size_t len) {
+    size_t used = 0;
+    out[0] = '\0';
+    for (int i = 0; i < players; i++) {
+        int written = snprintf(out + used, len - used, "%s:%d ", names[i], pos[i]);
+        if (written < 0 || (size_t)written >= len - used) {
+            break;
+        }
+        used += (size_t)written;
+    }
+}
+
+static void encode_move(OutBuf *out, Format f, const Board *b, int seat, const int *pos, int players,
+                        const TurnResult *r) {
+    char line[512];
+    switch (f) {
+    case FMT_TEXT:
+        positions_line(pos, players, line, sizeof(line));
+        text_move(out, board_size(b), names[seat], r, line);
+        break;
+    case FMT_DELTA:
+        text_move(out, board_size(b), names[seat], r, "");
+        outbuf_printf(out, "@D %d:%d\n", seat + 1, r->after);
+        break;
+    default: {
+        wire_roll_result(out, seat, r);
+        size_t at = wire_begin(out, WIRE_POSITIONS);
+        wire_u8(out, (unsigned)seat);
+        wire_u32(out, (uint32_t)r->after);
+        wire_end(out, at);
+        break;
+    }
+    }
+}
+
+/* Emulate linebuf_fill from memory. */
+static size_t feed(LineBuf *lb, const char *src, size_t len, size_t off) {
+    if (lb->head > 0) {
+        memmove(lb->data, lb->data + lb->head, lb->len);
+        lb->head = 0;
+    }
+    size_t take = sizeof(lb->data) - lb->len;
+    if (take > len - off) {
+        take = len - off;
+    }
+    memcpy(lb->data + lb->len, src + off, take);
+    lb->len += take;
+    return off + take;
+}
+
+/* Parse a whole stream like the client; returns a checksum so nothing is optimized out. */
+static unsigned long parse_stream(Format f, const char *data, size_t len) {
+    LineBuf lb;
+    linebuf_init(&lb, -1);
+    unsigned long sum = 0;
+    size_t off = 0;
+    char line[512];
+    uint8_t frame[LINEBUF_SIZE];
+    WireMsg m;
+
+    for (;;) {
+        off = feed(&lb, data, len, off);
+        if (f == FMT_BINARY) {
+            int n;
+            while ((n = wire_pop(&lb, frame)) >= 0) {
+                if (wire_decode(frame, (size_t)n, &m) == 0) {
+                    sum += m.type + m.b;
+                }
+            }
+        } else {
+            int n;
+            while ((n = linebuf_pop(&lb, line, sizeof(line))) >= 0) {
+                sum += (unsigned long)n + (strncmp(line, "YOUR_TURN", 9) == 0);
+                if (line[0] == '@' && line[1] == 'D') {
+                    int seat = 0;
+                    int pos = 0;
+                    if (sscanf(line + 2, " %d:%d", &seat, &pos) == 2) {
+                        sum += (unsigned long)pos;
+                    }
+                }
+            }
+        }
+        if (off >= len) {
+            break;
+        }
+    }
+    return sum;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-n moves] [-p players]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    long moves = 200000;
+    int players = 3;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            moves = atol(optarg);
+            break;
+        case 'p':
+            players = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (moves < 1 || players < 1 || players > BENCH_PLAYERS_MAX) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Board board;
+    board_init_default(&board);
+
+    /* One game's worth of moves, replayed until `moves` are encoded. */
+    printf("%-8s %12s %14s %14s\n", "format", "bytes/move", "format ns/move", "parse ns/move");
+    for (int f = 0; f < FMT_COUNT; f++) {
+        DiceRng dice;
+        dice_seed(&dice, 42, 0);
+        int pos[BENCH_PLAYERS_MAX] = {0};
+        OutBuf out;
+        outbuf_init(&out, -1);
+
+        double start = now_s();
+        for (long i = 0; i < moves; i++) {
+            int seat = (int)(i % players);
+            TurnResult r;
+            board_turn(&board, &pos[seat], dice_roll(&dice), &r);
+            encode_move(&out, (Format)f, &board, seat, pos, players, &r);
+            if (r.won) {
+                memset(pos, 0, sizeof(pos));
+            }
+        }
+        double format_s = now_s() - start;
+        if (out.failed) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+
+        start = now_s();
+        unsigned long sum = parse_stream((Format)f, out.data, out.len);
+        double parse_s = now_s() - start;
+
+        printf("%-8s %12.1f %14.1f %14.1f\n", format_name[f], (double)out.len / (double)moves,
+               format_s * 1e9 / (double)moves, parse_s * 1e9 / (double)moves);
+        if (sum == 0) {
+            fprintf(stderr, "nothing parsed\n");
+        }
+        outbuf_free(&out);
+    }
+    board_free(&board);
+    return 0;
+}